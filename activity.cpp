@@ -0,0 +1,47 @@
+#include "activity.h"
+
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+double processCpuSeconds() {
+#ifdef _WIN32
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+		return 0.0;
+	}
+
+	// FILETIMEs count 100 ns intervals
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernelTime.dwLowDateTime;
+	kernel.HighPart = kernelTime.dwHighDateTime;
+	user.LowPart = userTime.dwLowDateTime;
+	user.HighPart = userTime.dwHighDateTime;
+
+	return (double)(kernel.QuadPart + user.QuadPart) * 1e-7;
+#else
+	timespec time;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+
+	return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+#endif
+}
+
+double packageEnergyJoules() {
+	// Usually root-only to read, in which case we just don't report power
+	std::ifstream file("/sys/class/powercap/intel-rapl:0/energy_uj");
+	unsigned long long microjoules = 0;
+
+	if (!(file >> microjoules)) {
+		return -1.0;
+	}
+
+	return (double)microjoules * 1e-6;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+/*
+Process CPU time and (where the OS exposes it) CPU package energy, sampled to report how much an idle window costs.
+*/
+
+// CPU time used by every thread of this process so far, in seconds
+extern double processCpuSeconds();
+
+// Cumulative CPU package energy in joules from Linux powercap (RAPL); negative where unavailable
+extern double packageEnergyJoules();
@@ -0,0 +1,441 @@
+#include "allocator.h"
+#include "log.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+const char* memoryPurposeName(MemoryPurpose purpose) {
+	switch (purpose) {
+	case MemoryPurpose::Geometry:
+		return "geometry";
+	case MemoryPurpose::Uniforms:
+		return "uniforms";
+	case MemoryPurpose::Staging:
+		return "staging";
+	case MemoryPurpose::Attachments:
+		return "attachments";
+	case MemoryPurpose::Readback:
+		return "readback";
+	default:
+		return "unknown";
+	}
+}
+
+void DeviceAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device, bool memoryBudget) {
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	this->memoryBudget = memoryBudget;
+
+	// Queried once, rather than on every findMemoryType call
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+}
+
+void DeviceAllocator::destroy() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (MemoryPool& pool : pools) {
+		for (auto& block : pool.blocks) {
+			if (block->allocationCount > 0) {
+				LogLine(LogLevel::Error) << "Allocator: block destroyed with " << block->allocationCount << " live allocations!";
+			}
+
+			freeDeviceMemory(block->memory, block->memoryType, block->size, block->mapped);
+		}
+
+		pool.blocks.clear();
+
+		if (pool.ring) {
+			freeDeviceMemory(pool.ring->memory, pool.ring->memoryType, pool.ring->size, pool.ring->mapped);
+			pool.ring.reset();
+		}
+	}
+}
+
+uint32_t DeviceAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		// Correct memory types available AND all correct properties satisfied
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+// Small heaps (e.g. the 256 MiB host-visible device-local heap) get proportionally smaller blocks
+VkDeviceSize DeviceAllocator::blockSizeFor(uint32_t memoryType) const {
+	VkDeviceSize heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[memoryType].heapIndex].size;
+
+	return std::min(MAX_BLOCK_SIZE, heapSize / 8);
+}
+
+VkDeviceMemory DeviceAllocator::allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, void** mapped) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate device memory!");
+	}
+
+	*mapped = nullptr;
+
+	if (memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+			vkFreeMemory(device, memory, nullptr);
+			throw std::runtime_error("Failed to map device memory!");
+		}
+	}
+
+	deviceAllocationCount++;
+	peakDeviceAllocationCount = std::max(peakDeviceAllocationCount, deviceAllocationCount);
+
+	liveDeviceAllocations.store(deviceAllocationCount, std::memory_order_relaxed);
+	reservedBytes.fetch_add(size, std::memory_order_relaxed);
+
+	uint32_t heap = memProperties.memoryTypes[memoryType].heapIndex;
+	heapBytes[heap].add((int64_t)size);
+	heapAllocations[heap]++;
+
+	return memory;
+}
+
+void DeviceAllocator::freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryType, VkDeviceSize size, void* mapped) {
+	if (mapped != nullptr) {
+		vkUnmapMemory(device, memory);
+	}
+
+	vkFreeMemory(device, memory, nullptr);
+	deviceAllocationCount--;
+
+	liveDeviceAllocations.store(deviceAllocationCount, std::memory_order_relaxed);
+	reservedBytes.fetch_sub(size, std::memory_order_relaxed);
+
+	uint32_t heap = memProperties.memoryTypes[memoryType].heapIndex;
+	heapBytes[heap].remove((int64_t)size);
+	heapAllocations[heap]--;
+}
+
+// Best fit over the block's free ranges
+bool DeviceAllocator::allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation) {
+	auto best = block.freeRanges.end();
+	VkDeviceSize bestAligned = 0;
+
+	for (auto range = block.freeRanges.begin(); range != block.freeRanges.end(); range++) {
+		VkDeviceSize aligned = alignUp(range->first, alignment);
+
+		if (aligned + size <= range->first + range->second && (best == block.freeRanges.end() || range->second < best->second)) {
+			best = range;
+			bestAligned = aligned;
+		}
+	}
+
+	if (best == block.freeRanges.end()) {
+		return false;
+	}
+
+	VkDeviceSize rangeOffset = best->first;
+	VkDeviceSize rangeEnd = best->first + best->second;
+	block.freeRanges.erase(best);
+
+	// Alignment padding and the remainder both stay free
+	if (bestAligned > rangeOffset) {
+		block.freeRanges[rangeOffset] = bestAligned - rangeOffset;
+	}
+
+	if (bestAligned + size < rangeEnd) {
+		block.freeRanges[bestAligned + size] = rangeEnd - (bestAligned + size);
+	}
+
+	block.used += size;
+	block.allocationCount++;
+
+	usedBytes.fetch_add(size, std::memory_order_relaxed);
+
+	allocation.memory = block.memory;
+	allocation.offset = bestAligned;
+	allocation.size = size;
+	allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + bestAligned : nullptr;
+	allocation.block = &block;
+
+	return true;
+}
+
+bool DeviceAllocator::allocateFromRing(MemoryRing& ring, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation) {
+	VkDeviceSize start;
+
+	if (ring.entries.empty()) {
+		start = 0;
+
+		if (size > ring.size) {
+			return false;
+		}
+	}
+	else {
+		VkDeviceSize head = alignUp(ring.entries.back().end, alignment);
+		VkDeviceSize tail = ring.entries.front().offset;
+
+		if (ring.entries.back().end > tail) {
+			// Live region is [tail, head) - try after the head, then wrap around to the start
+			if (head + size <= ring.size) {
+				start = head;
+			}
+			else if (size <= tail) {
+				start = 0;
+			}
+			else {
+				return false;
+			}
+		}
+		else {
+			// Already wrapped - free space is [head, tail)
+			if (head + size <= tail) {
+				start = head;
+			}
+			else {
+				return false;
+			}
+		}
+	}
+
+	ring.entries.push_back({ start, start + size, false });
+
+	VkDeviceSize inUse = ring.entries.back().end >= ring.entries.front().offset
+		? ring.entries.back().end - ring.entries.front().offset
+		: ring.size - ring.entries.front().offset + ring.entries.back().end;
+	ring.highWater = std::max(ring.highWater, inUse);
+
+	allocation.memory = ring.memory;
+	allocation.offset = start;
+	allocation.size = size;
+	allocation.mapped = ring.mapped ? static_cast<char*>(ring.mapped) + start : nullptr;
+	allocation.ring = &ring;
+
+	usedBytes.fetch_add(size, std::memory_order_relaxed);
+
+	return true;
+}
+
+Allocation DeviceAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryPurpose purpose,
+	AllocationLifetime lifetime, bool optimalImage) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Allocation allocation{};
+	allocation.memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+	allocation.purpose = purpose;
+	purposeBytes[(size_t)purpose].add((int64_t)requirements.size);
+
+	MemoryPool& pool = pools[allocation.memoryType + (optimalImage ? VK_MAX_MEMORY_TYPES : 0)];
+	VkDeviceSize alignment = std::max<VkDeviceSize>(1, requirements.alignment);
+
+	totalSubAllocations++;
+
+	// Staging data goes through the ring if it fits, otherwise falls back to the free-list
+	if (lifetime == AllocationLifetime::Transient && !optimalImage) {
+		if (!pool.ring) {
+			pool.ring = std::make_unique<MemoryRing>();
+			pool.ring->size = RING_SIZE;
+			pool.ring->memoryType = allocation.memoryType;
+			pool.ring->memory = allocateDeviceMemory(allocation.memoryType, RING_SIZE, &pool.ring->mapped);
+		}
+
+		if (allocateFromRing(*pool.ring, requirements.size, alignment, allocation)) {
+			return allocation;
+		}
+	}
+
+	for (auto& block : pool.blocks) {
+		if (!block->dedicated && allocateFromBlock(*block, requirements.size, alignment, allocation)) {
+			return allocation;
+		}
+	}
+
+	// No room - open a new block, or a dedicated one for allocations that would hog most of a block
+	VkDeviceSize blockSize = blockSizeFor(allocation.memoryType);
+	bool dedicated = requirements.size > blockSize / 2;
+
+	auto block = std::make_unique<MemoryBlock>();
+	block->size = dedicated ? requirements.size : blockSize;
+	block->dedicated = dedicated;
+	block->memoryType = allocation.memoryType;
+	block->memory = allocateDeviceMemory(allocation.memoryType, block->size, &block->mapped);
+	block->freeRanges[0] = block->size;
+
+	allocateFromBlock(*block, requirements.size, alignment, allocation);
+	pool.blocks.push_back(std::move(block));
+
+	return allocation;
+}
+
+void DeviceAllocator::free(Allocation& allocation) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (allocation.ring != nullptr || allocation.block != nullptr) {
+		usedBytes.fetch_sub(allocation.size, std::memory_order_relaxed);
+		purposeBytes[(size_t)allocation.purpose].remove((int64_t)allocation.size);
+	}
+
+	if (allocation.ring != nullptr) {
+		MemoryRing& ring = *allocation.ring;
+
+		for (auto& entry : ring.entries) {
+			if (entry.offset == allocation.offset && !entry.freed) {
+				entry.freed = true;
+				break;
+			}
+		}
+
+		// Only the tail can actually be reclaimed
+		while (!ring.entries.empty() && ring.entries.front().freed) {
+			ring.entries.pop_front();
+		}
+	}
+	else if (allocation.block != nullptr) {
+		MemoryBlock& block = *allocation.block;
+
+		VkDeviceSize offset = allocation.offset;
+		VkDeviceSize size = allocation.size;
+
+		// Coalesce with the neighbouring free ranges
+		auto next = block.freeRanges.lower_bound(offset);
+
+		if (next != block.freeRanges.begin()) {
+			auto previous = std::prev(next);
+
+			if (previous->first + previous->second == offset) {
+				offset = previous->first;
+				size += previous->second;
+				block.freeRanges.erase(previous);
+			}
+		}
+
+		if (next != block.freeRanges.end() && next->first == allocation.offset + allocation.size) {
+			size += next->second;
+			block.freeRanges.erase(next);
+		}
+
+		block.freeRanges[offset] = size;
+		block.used -= allocation.size;
+		block.allocationCount--;
+
+		// Give empty blocks back to the driver, but keep one shared block per pool around for reuse
+		if (block.allocationCount == 0) {
+			for (MemoryPool& pool : pools) {
+				auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [&](const auto& b) { return b.get() == &block; });
+
+				if (it == pool.blocks.end()) {
+					continue;
+				}
+
+				size_t sharedBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const auto& b) { return !b->dedicated; });
+
+				if (block.dedicated || sharedBlocks > 1) {
+					freeDeviceMemory(block.memory, block.memoryType, block.size, block.mapped);
+					pool.blocks.erase(it);
+				}
+
+				break;
+			}
+		}
+	}
+
+	allocation = Allocation{};
+}
+
+void DeviceAllocator::printStatistics() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	LogLine(LogLevel::Info) << "Device memory: " << deviceAllocationCount << " vkAllocateMemory allocations (peak " << peakDeviceAllocationCount
+		<< ") serving " << totalSubAllocations << " sub-allocations";
+
+	for (uint32_t i = 0; i < 2 * VK_MAX_MEMORY_TYPES; i++) {
+		MemoryPool& pool = pools[i];
+
+		if (pool.blocks.empty() && !pool.ring) {
+			continue;
+		}
+
+		VkDeviceSize reserved = 0;
+		VkDeviceSize used = 0;
+		VkDeviceSize totalFree = 0;
+		VkDeviceSize largestFree = 0;
+		uint32_t allocations = 0;
+		size_t freeRanges = 0;
+
+		for (auto& block : pool.blocks) {
+			reserved += block->size;
+			used += block->used;
+			allocations += block->allocationCount;
+			freeRanges += block->freeRanges.size();
+
+			for (auto& range : block->freeRanges) {
+				totalFree += range.second;
+				largestFree = std::max(largestFree, range.second);
+			}
+		}
+
+		// 0% = all free space is one contiguous range, -> 100% = free space shattered into tiny pieces
+		float fragmentation = totalFree > 0 ? 100.0f * (1.0f - (float)largestFree / (float)totalFree) : 0.0f;
+
+		LogLine line(LogLevel::Info);
+		line << "\tType " << (i % VK_MAX_MEMORY_TYPES) << (i >= VK_MAX_MEMORY_TYPES ? " (images)" : "")
+			<< ": " << pool.blocks.size() << " blocks, " << used / 1024 << " / " << reserved / 1024 << " KiB used by "
+			<< allocations << " allocations, " << freeRanges << " free ranges, " << fragmentation << "% fragmented";
+
+		if (pool.ring) {
+			line << ", ring " << pool.ring->entries.size() << " live, high water " << pool.ring->highWater / 1024
+				<< " / " << pool.ring->size / 1024 << " KiB";
+		}
+	}
+}
+
+void DeviceAllocator::reportUsage() {
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+	budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	// The driver refreshes the budget whenever it is queried, so this is current as of now
+	if (memoryBudget) {
+		VkPhysicalDeviceMemoryProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties.pNext = &budget;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (uint32_t heap = 0; heap < memProperties.memoryHeapCount; heap++) {
+		const MemoryCounter& counter = heapBytes[heap];
+
+		if (counter.getPeak() == 0 && !memoryBudget) {
+			continue;
+		}
+
+		LogLine line(LogLevel::Info);
+		line << "Device heap " << heap << (memProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? " (device local)" : " (host)")
+			<< ": " << counter.getCurrent() / 1024 << " KiB in " << heapAllocations[heap] << " allocations (peak " << counter.getPeak() / 1024
+			<< " KiB) of " << memProperties.memoryHeaps[heap].size / (1024 * 1024) << " MiB";
+
+		// Usage is the whole process (and on some drivers other processes too), not just what went through this allocator
+		if (memoryBudget) {
+			line << ", process usage " << budget.heapUsage[heap] / (1024 * 1024) << " MiB of a " << budget.heapBudget[heap] / (1024 * 1024)
+				<< " MiB budget";
+		}
+	}
+
+	LogLine line(LogLevel::Info);
+	line << "Device memory by purpose:";
+
+	for (size_t i = 0; i < (size_t)MemoryPurpose::Count; i++) {
+		const MemoryCounter& counter = purposeBytes[i];
+
+		line << (i > 0 ? "," : "") << " " << memoryPurposeName((MemoryPurpose)i) << " " << counter.getCurrent() / 1024 << " KiB (peak "
+			<< counter.getPeak() / 1024 << ")";
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "memoryAccounting.h"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+Sub-allocates device memory out of large blocks, so the number of vkAllocateMemory calls stays small no matter how many
+buffers we create (drivers cap the allocation count, and each allocation has a fixed overhead).
+
+ - Persistent allocations come from per-memory-type pools of blocks, managed with a coalescing free-list
+ - Transient allocations (staging data) come from a per-memory-type linear ring, and must be freed roughly in order
+ - Host-visible blocks are mapped once, for their whole lifetime
+
+Every vkAllocateMemory is counted against its heap, and every sub-allocation against its purpose - both with current and
+peak bytes. With VK_EXT_memory_budget the report also shows what the driver says the whole process uses of each heap, and
+how much it may use before allocations start failing or spilling into system memory.
+*/
+
+enum class AllocationLifetime {
+	Persistent,
+	Transient
+};
+
+// What the memory is for, so usage can be reported per subsystem
+enum class MemoryPurpose {
+	Geometry,
+	Uniforms,
+	Staging,
+	Attachments, // Depth and offscreen colour images
+	Readback, // Batch and capture readback buffers
+	Count
+};
+
+const char* memoryPurposeName(MemoryPurpose purpose);
+
+struct MemoryBlock;
+struct MemoryRing;
+
+struct Allocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr; // Null unless the memory is host-visible
+
+	uint32_t memoryType = 0;
+	MemoryPurpose purpose = MemoryPurpose::Geometry;
+
+	// Where the allocation came from; exactly one is set for a live allocation
+	MemoryBlock* block = nullptr;
+	MemoryRing* ring = nullptr;
+};
+
+struct MemoryBlock {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+	uint32_t memoryType = 0;
+	void* mapped = nullptr;
+
+	std::map<VkDeviceSize, VkDeviceSize> freeRanges; // Offset --> size, never adjacent
+	VkDeviceSize used = 0;
+	uint32_t allocationCount = 0;
+	bool dedicated = false; // Holds a single allocation too big to share a block
+};
+
+struct MemoryRing {
+	struct Entry {
+		VkDeviceSize offset;
+		VkDeviceSize end;
+		bool freed;
+	};
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+	uint32_t memoryType = 0;
+	void* mapped = nullptr;
+
+	std::deque<Entry> entries; // In allocation order; the front is the tail of the ring
+	VkDeviceSize highWater = 0;
+};
+
+struct MemoryPool {
+	std::vector<std::unique_ptr<MemoryBlock>> blocks;
+	std::unique_ptr<MemoryRing> ring;
+};
+
+class DeviceAllocator {
+public:
+	// memoryBudget: VK_EXT_memory_budget was enabled on the device
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, bool memoryBudget);
+	void destroy();
+
+	// optimalImage: the resource is an optimally-tiled image, which must not share a page with linear resources
+	Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryPurpose purpose,
+		AllocationLifetime lifetime = AllocationLifetime::Persistent, bool optimalImage = false);
+	void free(Allocation& allocation);
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return memProperties; }
+
+	void printStatistics();
+
+	// Current and peak usage per heap and per purpose, plus the driver's budget when VK_EXT_memory_budget is enabled
+	void reportUsage();
+
+	// Lock-free, so they can be sampled every frame
+	VkDeviceSize getReservedBytes() const { return reservedBytes.load(std::memory_order_relaxed); }
+	VkDeviceSize getUsedBytes() const { return usedBytes.load(std::memory_order_relaxed); }
+	uint32_t getDeviceAllocationCount() const { return liveDeviceAllocations.load(std::memory_order_relaxed); }
+
+	static constexpr VkDeviceSize MAX_BLOCK_SIZE = 64ull * 1024 * 1024;
+	static constexpr VkDeviceSize RING_SIZE = 32ull * 1024 * 1024;
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memProperties{};
+	bool memoryBudget = false;
+
+	std::mutex mutex;
+
+	// Linear resources in [0, VK_MAX_MEMORY_TYPES), optimal images in [VK_MAX_MEMORY_TYPES, 2 * VK_MAX_MEMORY_TYPES). Never
+	// sharing a block is what keeps them bufferImageGranularity apart, so offsets only need each resource's own alignment
+	MemoryPool pools[2 * VK_MAX_MEMORY_TYPES];
+
+	uint32_t deviceAllocationCount = 0; // Live vkAllocateMemory allocations
+	uint32_t peakDeviceAllocationCount = 0;
+	uint64_t totalSubAllocations = 0;
+
+	std::atomic<VkDeviceSize> reservedBytes{ 0 }; // Allocated from the driver
+	std::atomic<VkDeviceSize> usedBytes{ 0 }; // Handed out to resources
+	std::atomic<uint32_t> liveDeviceAllocations{ 0 }; // deviceAllocationCount, readable without the mutex
+
+	MemoryCounter heapBytes[VK_MAX_MEMORY_HEAPS]; // vkAllocateMemory, per heap
+	uint32_t heapAllocations[VK_MAX_MEMORY_HEAPS] = {}; // Live, under the mutex
+	MemoryCounter purposeBytes[(size_t)MemoryPurpose::Count]; // Sub-allocations, per purpose
+
+	VkDeviceSize blockSizeFor(uint32_t memoryType) const;
+	VkDeviceMemory allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, void** mapped);
+	void freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryType, VkDeviceSize size, void* mapped);
+
+	bool allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+	bool allocateFromRing(MemoryRing& ring, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+};
@@ -0,0 +1,152 @@
+#include "batch.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+static void skipWhitespace(const std::string& line, size_t& i) {
+	while (i < line.size() && std::isspace((unsigned char)line[i])) {
+		i++;
+	}
+}
+
+static bool parseString(const std::string& line, size_t& i, std::string& value) {
+	if (i >= line.size() || line[i] != '"') {
+		return false;
+	}
+
+	value.clear();
+	i++;
+
+	while (i < line.size() && line[i] != '"') {
+		// Simple escapes only - names and keys are plain ASCII
+		if (line[i] == '\\' && i + 1 < line.size()) {
+			i++;
+		}
+
+		value += line[i++];
+	}
+
+	if (i >= line.size()) {
+		return false;
+	}
+
+	i++;
+
+	return true;
+}
+
+bool parseBatchJob(const std::string& line, BatchJob& job, std::string& error) {
+	size_t i = 0;
+	skipWhitespace(line, i);
+
+	if (i >= line.size() || line[i] != '{') {
+		error = "expected '{'";
+		return false;
+	}
+
+	i++;
+	skipWhitespace(line, i);
+
+	if (i < line.size() && line[i] == '}') {
+		return true;
+	}
+
+	while (i < line.size()) {
+		std::string key;
+
+		skipWhitespace(line, i);
+
+		if (!parseString(line, i, key)) {
+			error = "expected a key";
+			return false;
+		}
+
+		skipWhitespace(line, i);
+
+		if (i >= line.size() || line[i] != ':') {
+			error = "expected ':' after \"" + key + "\"";
+			return false;
+		}
+
+		i++;
+		skipWhitespace(line, i);
+
+		if (i < line.size() && line[i] == '"') {
+			std::string value;
+
+			if (!parseString(line, i, value)) {
+				error = "unterminated string for \"" + key + "\"";
+				return false;
+			}
+
+			if (key == "name") {
+				job.name = value;
+			}
+		}
+		else {
+			const char* start = line.c_str() + i;
+			char* end = nullptr;
+			double value = std::strtod(start, &end);
+
+			if (end == start) {
+				error = "expected a number or string for \"" + key + "\"";
+				return false;
+			}
+
+			if (!std::isfinite(value)) {
+				error = "expected a finite number for \"" + key + "\"";
+				return false;
+			}
+
+			i += end - start;
+
+			if (key == "m") job.shape.m = (float)value;
+			else if (key == "n1") job.shape.n1 = (float)value;
+			else if (key == "n2") job.shape.n2 = (float)value;
+			else if (key == "n3") job.shape.n3 = (float)value;
+			else if (key == "a") job.shape.a = (float)value;
+			else if (key == "b") job.shape.b = (float)value;
+			else if (key == "width" || key == "height") {
+				// Checked before the conversion - a negative or huge double doesn't convert to uint32_t
+				if (value < 1.0 || value > 16384.0) {
+					error = "width and height must be between 1 and 16384";
+					return false;
+				}
+
+				(key == "width" ? job.width : job.height) = (uint32_t)value;
+			}
+		}
+
+		skipWhitespace(line, i);
+
+		if (i < line.size() && line[i] == ',') {
+			i++;
+			continue;
+		}
+
+		if (i < line.size() && line[i] == '}') {
+			break;
+		}
+
+		error = "expected ',' or '}'";
+		return false;
+	}
+
+	if (i >= line.size()) {
+		error = "expected '}'";
+		return false;
+	}
+
+	if (job.width == 0 || job.height == 0 || job.width > 16384 || job.height > 16384) {
+		error = "width and height must be between 1 and 16384";
+		return false;
+	}
+
+	if (job.shape.n1 == 0.0f || job.shape.a == 0.0f || job.shape.b == 0.0f) {
+		error = "n1, a and b must be non-zero";
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "struct.h"
+#include "allocator.h"
+
+/*
+Batch jobs arrive as JSON lines, one flat object per line, e.g.
+
+	{"name": "star", "m": 5, "n1": 0.3, "n2": 0.3, "n3": 0.3, "width": 256, "height": 256}
+
+Every key is optional: the shape defaults to SupershapeParams' defaults, the size to 512x512, and the name to the job's
+line number. Unknown keys are ignored.
+*/
+
+struct BatchJob {
+	std::string name;
+	SupershapeParams shape{};
+
+	uint32_t width = 512;
+	uint32_t height = 512;
+};
+
+// One per frame in flight: the job rendered in that slot, and the host-visible buffer its image is copied back into
+struct BatchSlot {
+	VkBuffer readbackBuffer = VK_NULL_HANDLE;
+	Allocation readbackAllocation;
+	VkDeviceSize readbackSize = 0;
+
+	bool pending = false; // Submitted, but not yet written out
+	BatchJob job;
+};
+
+// Returns false with a reason in error if the line isn't a flat JSON object of numbers and strings
+extern bool parseBatchJob(const std::string& line, BatchJob& job, std::string& error);
@@ -0,0 +1,194 @@
+#include "capture.h"
+#include "imageWriter.h"
+#include "log.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+void FrameCapture::start(const std::string& directory, CaptureFormat format, uint32_t slotCount, uint32_t threadCount, uint32_t framesPerSecond) {
+	this->directory = directory;
+	this->format = format;
+	this->framesPerSecond = framesPerSecond;
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	slots.assign(slotCount, SlotState::Free);
+	stopping = false;
+
+	for (uint32_t i = 0; i < threadCount; i++) {
+		encoders.emplace_back(&FrameCapture::encoderLoop, this);
+	}
+}
+
+void FrameCapture::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	jobReady.notify_all();
+
+	for (std::thread& encoder : encoders) {
+		encoder.join();
+	}
+
+	encoders.clear();
+
+	if (stream.is_open()) {
+		stream.close();
+	}
+}
+
+int FrameCapture::acquireSlot(bool block) {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	auto findFree = [this]() {
+		for (size_t i = 0; i < slots.size(); i++) {
+			if (slots[i] == SlotState::Free) {
+				return (int)i;
+			}
+		}
+
+		return -1;
+	};
+
+	int slot = findFree();
+
+	if (slot < 0 && !block) {
+		droppedFrames++;
+		return -1;
+	}
+
+	if (slot < 0) {
+		auto blockStart = std::chrono::high_resolution_clock::now();
+
+		slotFreed.wait(lock, [&]() { return (slot = findFree()) >= 0; });
+
+		blockedFrames++;
+		blockedMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - blockStart).count();
+	}
+
+	slots[slot] = SlotState::Copying;
+
+	return slot;
+}
+
+void FrameCapture::submit(uint32_t slot, const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra, uint64_t frame) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		slots[slot] = SlotState::Encoding;
+		jobs.push_back({ slot, pixels, width, height, bgra, frame, nextSequence++ });
+	}
+
+	jobReady.notify_one();
+}
+
+void FrameCapture::encoderLoop() {
+	std::vector<uint8_t> scratch;
+
+	while (true) {
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+			// Queued frames are still written when stopping
+			if (jobs.empty()) {
+				return;
+			}
+
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		encode(job, scratch);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slots[job.slot] = SlotState::Free;
+		}
+
+		slotFreed.notify_one();
+	}
+}
+
+void FrameCapture::encode(const Job& job, std::vector<uint8_t>& scratch) {
+	if (format == CaptureFormat::Png) {
+		toRgb(job.pixels, job.width, job.height, job.bgra, scratch);
+
+		char filename[32];
+		std::snprintf(filename, sizeof(filename), "frame_%06llu.png", (unsigned long long)job.frame);
+
+		std::string path = (std::filesystem::path(directory) / filename).string();
+		bool written = writePng(path, job.width, job.height, scratch.data());
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (written) {
+			encodedFrames++;
+		}
+		else {
+			LogLine(LogLevel::Warning) << "Failed to write " << path << "!";
+		}
+
+		return;
+	}
+
+	// The conversion is the expensive part, and happens before waiting for this frame's turn
+	toYuv420(job.pixels, job.width, job.height, job.bgra, scratch);
+
+	bool written = false;
+
+	std::unique_lock<std::mutex> writeLock(writeMutex);
+	writeTurn.wait(writeLock, [&]() { return nextWrite == job.sequence; });
+
+	if (!stream.is_open()) {
+		std::string path = (std::filesystem::path(directory) / "capture.y4m").string();
+		stream.open(path, std::ios::binary | std::ios::trunc);
+
+		if (!stream.is_open()) {
+			LogLine(LogLevel::Warning) << "Failed to open " << path << "!";
+		}
+
+		streamWidth = job.width;
+		streamHeight = job.height;
+
+		stream << "YUV4MPEG2 W" << streamWidth << " H" << streamHeight << " F" << framesPerSecond << ":1 Ip A1:1 C420jpeg\n";
+	}
+
+	// A Y4M stream can't change size mid-way
+	if (job.width == streamWidth && job.height == streamHeight && stream.is_open()) {
+		stream << "FRAME\n";
+		stream.write(reinterpret_cast<const char*>(scratch.data()), scratch.size());
+		written = true;
+	}
+
+	nextWrite++;
+	writeLock.unlock();
+	writeTurn.notify_all();
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (written) {
+		encodedFrames++;
+	}
+	else {
+		skippedFrames++;
+	}
+}
+
+void FrameCapture::printStatistics() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	LogLine report(LogLevel::Info);
+	report << "Capture: " << encodedFrames << " frames encoded, " << droppedFrames << " dropped, " << blockedFrames << " blocked for "
+		<< blockedMs << " ms in total";
+
+	if (skippedFrames > 0) {
+		report << ", " << skippedFrames << " skipped after a resize";
+	}
+}
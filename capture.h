@@ -0,0 +1,102 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "allocator.h"
+
+/*
+Frame capture. The renderer copies chosen frames into a fixed ring of host-visible readback buffers; once a frame's fence
+has passed, its buffer is handed to a pool of encoder threads, and becomes free again when they are done with it.
+
+Back-pressure is explicit: when every buffer is still being copied into or encoded, a frame is either dropped or the render
+loop blocks until an encoder frees one - both are counted.
+*/
+
+enum class CaptureFormat {
+	Png, // One numbered file per frame
+	Y4m  // A single raw YUV 4:2:0 stream, at the size of the first frame captured
+};
+
+// The GPU side of a ring slot, owned by the renderer
+struct CaptureBuffer {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	Allocation allocation;
+	VkDeviceSize size = 0;
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t frame = 0;
+};
+
+class FrameCapture {
+public:
+	void start(const std::string& directory, CaptureFormat format, uint32_t slotCount, uint32_t threadCount, uint32_t framesPerSecond);
+
+	// Encodes everything already handed over, then joins the encoder threads
+	void stop();
+
+	// A free slot to copy this frame into, or -1 if there is none and we may not block
+	int acquireSlot(bool block);
+
+	// The copy into the slot has completed - pixels must stay valid until the slot is free again
+	void submit(uint32_t slot, const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra, uint64_t frame);
+
+	void printStatistics();
+
+private:
+	enum class SlotState {
+		Free,
+		Copying, // Reserved for a frame still on the GPU
+		Encoding
+	};
+
+	struct Job {
+		uint32_t slot;
+		const uint8_t* pixels;
+		uint32_t width;
+		uint32_t height;
+		bool bgra;
+		uint64_t frame;
+		uint64_t sequence; // Submission order, which the Y4M stream is written in
+	};
+
+	std::string directory;
+	CaptureFormat format = CaptureFormat::Png;
+	uint32_t framesPerSecond = 60;
+
+	std::vector<SlotState> slots;
+	std::deque<Job> jobs;
+	std::vector<std::thread> encoders;
+	bool stopping = false;
+
+	std::mutex mutex;
+	std::condition_variable jobReady;
+	std::condition_variable slotFreed;
+
+	// Y4M frames are converted in parallel but written strictly in order - under their own lock, so a slow disk never holds
+	// up acquireSlot() on the render thread
+	std::mutex writeMutex;
+	std::condition_variable writeTurn;
+	std::ofstream stream;
+	uint32_t streamWidth = 0;
+	uint32_t streamHeight = 0;
+	uint64_t nextSequence = 0;
+	uint64_t nextWrite = 0;
+
+	// Statistics
+	uint64_t encodedFrames = 0;
+	uint64_t droppedFrames = 0;
+	uint64_t blockedFrames = 0;
+	uint64_t skippedFrames = 0; // Y4M frames whose size no longer matches the stream
+	double blockedMs = 0.0;
+
+	void encoderLoop();
+	void encode(const Job& job, std::vector<uint8_t>& scratch);
+};
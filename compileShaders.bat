@@ -0,0 +1,9 @@
+@echo off
+rem Compiles the shaders to SPIR-V word lists, which shaders.cpp embeds into the binary
+if not exist shaders mkdir shaders
+glslc -mfmt=num shader.vert -o shaders/vert.spv.inc
+glslc -mfmt=num shader.frag -o shaders/frag.spv.inc
+
+rem Plain SPIR-V, only needed for the SUPERSHAPE_SHADER_DIR development override
+glslc shader.vert -o shaders/vert.spv
+glslc shader.frag -o shaders/frag.spv
@@ -0,0 +1,360 @@
+#include "controlPlane.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+const int CONTROL_POLL_MS = 100; // How long the control thread waits for input before checking whether it should stop
+
+#ifndef _WIN32
+// Only ever removes a socket - a mistyped path must not delete a regular file
+static void unlinkSocket(const char* path) {
+	struct stat existing;
+
+	if (lstat(path, &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+		unlink(path);
+	}
+}
+#endif
+
+bool applyControlCommand(const std::string& line, ControlState& state, std::string& error) {
+	struct ShapeKey {
+		const char* name;
+		float SupershapeParams::* field;
+		uint32_t bit;
+	};
+
+	static const ShapeKey shapeKeys[] = {
+		{ "m", &SupershapeParams::m, CONTROL_M },
+		{ "n1", &SupershapeParams::n1, CONTROL_N1 },
+		{ "n2", &SupershapeParams::n2, CONTROL_N2 },
+		{ "n3", &SupershapeParams::n3, CONTROL_N3 },
+		{ "a", &SupershapeParams::a, CONTROL_A },
+		{ "b", &SupershapeParams::b, CONTROL_B }
+	};
+
+	std::istringstream tokens(line);
+	ControlState next = state;
+
+	auto number = [&](float& value) {
+		std::string token;
+
+		if (!(tokens >> token)) {
+			return false;
+		}
+
+		char* end;
+		value = std::strtof(token.c_str(), &end);
+
+		return end != token.c_str() && *end == '\0' && std::isfinite(value);
+	};
+
+	std::string key;
+
+	while (tokens >> key) {
+		const ShapeKey* shapeKey = nullptr;
+
+		for (const ShapeKey& candidate : shapeKeys) {
+			if (key == candidate.name) {
+				shapeKey = &candidate;
+			}
+		}
+
+		if (shapeKey != nullptr) {
+			if (!number(next.shape.*(shapeKey->field))) {
+				error = "expected a number after \"" + key + "\"";
+				return false;
+			}
+
+			next.shapeFields |= shapeKey->bit;
+		}
+		else if (key == "eye") {
+			if (!number(next.eye.x) || !number(next.eye.y) || !number(next.eye.z)) {
+				error = "expected three numbers after \"eye\"";
+				return false;
+			}
+
+			next.eyeVersion++;
+		}
+		else if (key == "look") {
+			if (!number(next.theta) || !number(next.phi)) {
+				error = "expected two numbers after \"look\"";
+				return false;
+			}
+
+			next.lookVersion++;
+		}
+		else if (key == "release") {
+			next.shapeFields = 0;
+		}
+		else {
+			error = "unknown key \"" + key + "\"";
+			return false;
+		}
+	}
+
+	next.sequence++;
+	state = next;
+
+	return true;
+}
+
+// Every field a different function of the sequence, so a snapshot mixing two commands can't pass for either
+SupershapeParams controlStressShape(uint64_t sequence) {
+	SupershapeParams shape;
+	shape.m = 1.0f + (float)(sequence % 61) * 0.1f;
+	shape.n1 = 0.2f + (float)(sequence % 97) * 0.01f;
+	shape.n2 = 0.5f + (float)(sequence % 89) * 0.02f;
+	shape.n3 = 0.5f + (float)(sequence % 83) * 0.02f;
+	shape.a = 1.0f + (float)(sequence % 7) * 0.01f;
+	shape.b = 1.0f + (float)(sequence % 11) * 0.01f;
+
+	return shape;
+}
+
+bool ControlPlane::start(const char* source, uint32_t stressRate, std::function<void()> wake) {
+	this->source = source != nullptr ? source : "";
+	this->stressRate = stressRate;
+	this->wake = std::move(wake);
+
+#ifdef _WIN32
+	// Blocking console reads can't be interrupted to stop the thread cleanly
+	if (stressRate == 0) {
+		LogLine(LogLevel::Warning) << "Control: only the stress test is supported on Windows";
+		return false;
+	}
+#else
+	if (stressRate == 0 && this->source != "-") {
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+
+		if (this->source.empty() || this->source.size() >= sizeof(address.sun_path)) {
+			LogLine(LogLevel::Warning) << "Control: invalid socket path \"" << this->source << "\"";
+			return false;
+		}
+
+		std::strncpy(address.sun_path, this->source.c_str(), sizeof(address.sun_path) - 1);
+
+		// A socket left behind by a previous run would make bind() fail. Anything else there makes it fail on purpose
+		unlinkSocket(address.sun_path);
+
+		listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (listenSocket < 0 || bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenSocket, 1) != 0) {
+			LogLine(LogLevel::Warning) << "Control: failed to listen on " << this->source << " (" << std::strerror(errno) << ")";
+
+			if (listenSocket >= 0) {
+				close(listenSocket);
+				listenSocket = -1;
+			}
+
+			return false;
+		}
+	}
+#endif
+
+	startTime = std::chrono::steady_clock::now();
+	running.store(true, std::memory_order_release);
+	thread = std::thread(&ControlPlane::run, this);
+
+	if (stressRate > 0) {
+		LogLine(LogLevel::Info) << "Control: stress test at " << stressRate << " updates/s";
+	}
+	else {
+		LogLine(LogLevel::Info) << "Control: reading commands from " << (this->source == "-" ? "stdin" : this->source);
+	}
+
+	return true;
+}
+
+void ControlPlane::stop() {
+	if (!thread.joinable()) {
+		return;
+	}
+
+	running.store(false, std::memory_order_release);
+	thread.join();
+
+#ifndef _WIN32
+	if (listenSocket >= 0) {
+		close(listenSocket);
+		unlinkSocket(source.c_str());
+		listenSocket = -1;
+	}
+#endif
+}
+
+void ControlPlane::run() {
+	if (stressRate > 0) {
+		runStress();
+	}
+	else {
+		readSource();
+	}
+}
+
+// On an absolute schedule, so oversleeping one interval is made up in the next rather than lowering the rate
+void ControlPlane::runStress() {
+	auto interval = std::chrono::nanoseconds(1000000000ull / stressRate);
+	auto next = std::chrono::steady_clock::now();
+
+	char line[256];
+
+	while (running.load(std::memory_order_acquire)) {
+		SupershapeParams shape = controlStressShape(current.sequence + 1);
+
+		// %.9g round-trips a float exactly, so the parsed command carries exactly these values
+		std::snprintf(line, sizeof(line), "m %.9g n1 %.9g n2 %.9g n3 %.9g a %.9g b %.9g", shape.m, shape.n1, shape.n2, shape.n3, shape.a, shape.b);
+		handleLine(line);
+
+		next += interval;
+		auto now = std::chrono::steady_clock::now();
+
+		// Descheduled for a long time - carry on from now rather than send a burst
+		if (now - next > std::chrono::milliseconds(100)) {
+			next = now;
+		}
+
+		std::this_thread::sleep_until(next);
+	}
+}
+
+void ControlPlane::readSource() {
+#ifndef _WIN32
+	int input = source == "-" ? STDIN_FILENO : -1; // stdin, or the connected client
+	std::string pending;
+	char buffer[4096];
+
+	while (running.load(std::memory_order_acquire)) {
+		pollfd descriptor{};
+		descriptor.fd = input >= 0 ? input : listenSocket;
+		descriptor.events = POLLIN;
+
+		if (poll(&descriptor, 1, CONTROL_POLL_MS) <= 0) {
+			continue;
+		}
+
+		// One client at a time - the next connects once it has gone
+		if (input < 0) {
+			input = accept(listenSocket, nullptr, nullptr);
+			continue;
+		}
+
+		ssize_t length = read(input, buffer, sizeof(buffer));
+
+		if (length <= 0) {
+			if (input == STDIN_FILENO) {
+				break;
+			}
+
+			close(input);
+			input = -1;
+			pending.clear();
+			continue;
+		}
+
+		pending.append(buffer, (size_t)length);
+
+		size_t start = 0;
+		size_t end;
+
+		while ((end = pending.find('\n', start)) != std::string::npos) {
+			handleLine(pending.substr(start, end - start));
+			start = end + 1;
+		}
+
+		pending.erase(0, start);
+	}
+
+	if (input >= 0 && input != STDIN_FILENO) {
+		close(input);
+	}
+#endif
+}
+
+void ControlPlane::handleLine(const std::string& line) {
+	size_t first = line.find_first_not_of(" \t\r");
+
+	if (first == std::string::npos || line[first] == '#') {
+		return;
+	}
+
+	std::string error;
+
+	if (!applyControlCommand(line, current, error)) {
+		LogLine(LogLevel::Warning) << "Control: " << error << " in \"" << line << "\"";
+		return;
+	}
+
+	publish();
+}
+
+void ControlPlane::publish() {
+	current.publishTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+	snapshots.back() = current;
+	bool previousTaken = snapshots.publish();
+
+	published.fetch_add(1, std::memory_order_relaxed);
+
+	// The render loop may be asleep waiting for events - but only the first snapshot it hasn't seen needs to wake it
+	if (previousTaken && wake) {
+		wake();
+	}
+}
+
+bool ControlPlane::update() {
+	if (!snapshots.update()) {
+		return false;
+	}
+
+	const ControlState& snapshot = snapshots.front();
+	int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	double latencyUs = (double)(now - snapshot.publishTimeNs) / 1000.0;
+
+	taken++;
+	totalLatencyUs += latencyUs;
+	maxLatencyUs = std::max(maxLatencyUs, latencyUs);
+
+	if (snapshot.sequence <= lastSequence) {
+		reordered++;
+	}
+
+	lastSequence = snapshot.sequence;
+
+	if (stressRate > 0) {
+		SupershapeParams expected = controlStressShape(snapshot.sequence);
+
+		if (std::memcmp(&expected, &snapshot.shape, sizeof(SupershapeParams)) != 0) {
+			torn++;
+		}
+	}
+
+	return true;
+}
+
+void ControlPlane::printStatistics() const {
+	uint64_t publishedCount = published.load(std::memory_order_relaxed);
+	float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+
+	LogLine line(LogLevel::Info);
+	line << "Control: " << publishedCount << " updates published (" << (seconds > 0.0f ? publishedCount / seconds : 0.0f) << "/s), "
+		<< taken << " taken by frames, latency " << (taken > 0 ? totalLatencyUs / taken : 0.0) << " us average, " << maxLatencyUs << " us worst";
+
+	if (stressRate > 0) {
+		line << ", " << torn << " torn and " << reordered << " out-of-order snapshots";
+	}
+}
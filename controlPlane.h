@@ -0,0 +1,126 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "struct.h"
+#include "ring.h"
+
+/*
+External control of the shape and camera, from another thread, without ever blocking the render loop.
+
+A control thread reads text commands - from stdin, or from clients of a local UNIX socket (neither on Windows) - applies
+each to its own copy of the state, and publishes the result as a whole snapshot through a TripleBuffer. The render loop
+takes the latest snapshot once per frame, wait-free, and applies it when it updates the uniforms; intermediate snapshots
+are skipped, never queued.
+
+One command per line, any number of "key value..." pairs:
+
+	m 6 n1 0.3 n2 0.3 n3 0.3    shape parameters (m n1 n2 n3 a b); each one set stops the animation driving it
+	eye 0 -6 0                  camera position
+	look 1.57 1.57              camera direction, as theta and phi
+	release                     hands the shape back to the animation
+
+A stress mode replaces the source with synthetic shape commands at a fixed rate, sent through the same parser and buffer.
+Each encodes its sequence number in every field, so the render loop can check that no snapshot it takes is torn.
+*/
+
+// Bits of ControlState::shapeFields
+enum ControlShapeField : uint32_t {
+	CONTROL_M = 1 << 0,
+	CONTROL_N1 = 1 << 1,
+	CONTROL_N2 = 1 << 2,
+	CONTROL_N3 = 1 << 3,
+	CONTROL_A = 1 << 4,
+	CONTROL_B = 1 << 5
+};
+
+struct ControlState {
+	uint64_t sequence = 0; // Commands applied so far
+	int64_t publishTimeNs = 0; // steady_clock, for the latency the render loop sees
+
+	SupershapeParams shape{};
+	uint32_t shapeFields = 0; // Which fields of shape override the animation
+
+	// Bumped by every eye or look command, so each is applied once
+	uint64_t eyeVersion = 0;
+	uint64_t lookVersion = 0;
+	glm::vec3 eye{ 0.0f };
+	float theta = 0.0f;
+	float phi = 0.0f;
+};
+
+// Applies one command line to state; false with a reason in error if any of it was malformed (nothing is applied then)
+extern bool applyControlCommand(const std::string& line, ControlState& state, std::string& error);
+
+// Overrides the fields of shape that the controller has set
+inline void applyControlShape(const ControlState& state, SupershapeParams& shape) {
+	if (state.shapeFields & CONTROL_M) shape.m = state.shape.m;
+	if (state.shapeFields & CONTROL_N1) shape.n1 = state.shape.n1;
+	if (state.shapeFields & CONTROL_N2) shape.n2 = state.shape.n2;
+	if (state.shapeFields & CONTROL_N3) shape.n3 = state.shape.n3;
+	if (state.shapeFields & CONTROL_A) shape.a = state.shape.a;
+	if (state.shapeFields & CONTROL_B) shape.b = state.shape.b;
+}
+
+// The shape the stress mode sends as its sequence-th command
+extern SupershapeParams controlStressShape(uint64_t sequence);
+
+class ControlPlane {
+public:
+	~ControlPlane() { stop(); }
+
+	// source: "-" for stdin, otherwise the path of a UNIX socket to listen on. stressRate > 0 ignores the source and
+	// sends that many synthetic updates per second instead. wake is called from the control thread when a snapshot
+	// arrives while the render loop may be asleep
+	bool start(const char* source, uint32_t stressRate, std::function<void()> wake);
+	void stop();
+
+	bool isRunning() const { return thread.joinable(); }
+
+	// Render thread: takes the latest snapshot if there is a new one, wait-free. The result stays valid until the next call
+	bool update();
+	const ControlState& state() const { return snapshots.front(); }
+
+	// Whether a snapshot the render loop hasn't taken yet is waiting
+	bool pending() const { return snapshots.pending(); }
+
+	// Publish and take counts, latency, and (stress mode) torn or out-of-order snapshots
+	void printStatistics() const;
+
+private:
+	TripleBuffer<ControlState> snapshots;
+
+	std::string source;
+	uint32_t stressRate = 0;
+	std::function<void()> wake;
+
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	int listenSocket = -1;
+
+	// Control thread
+	ControlState current;
+	std::atomic<uint64_t> published{ 0 };
+	std::chrono::steady_clock::time_point startTime;
+
+	// Render thread
+	uint64_t taken = 0;
+	uint64_t lastSequence = 0;
+	uint64_t torn = 0;
+	uint64_t reordered = 0;
+	double totalLatencyUs = 0.0;
+	double maxLatencyUs = 0.0;
+
+	void run();
+	void runStress();
+	void readSource();
+	void handleLine(const std::string& line);
+	void publish();
+};
@@ -0,0 +1,91 @@
+#include "fastMath.h"
+#include "gielis.h"
+#include "log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// A spread of shapes around the defaults, including the sharp low-n1 ones that amplify pow's error most
+static std::vector<SupershapeParams> sampleShapes() {
+	std::vector<SupershapeParams> shapes;
+
+	const float ms[] = { 0.0f, 2.0f, 3.5f, 5.0f, 7.0f };
+	const float n1s[] = { 0.2f, 0.5f, 1.0f, 4.0f };
+	const float n23s[] = { 0.3f, 1.0f, 1.7f, 4.0f };
+
+	for (float m : ms) {
+		for (float n1 : n1s) {
+			for (float n23 : n23s) {
+				SupershapeParams shape{};
+				shape.m = m;
+				shape.n1 = n1;
+				shape.n2 = n23;
+				shape.n3 = n23;
+				shapes.push_back(shape);
+			}
+		}
+	}
+
+	return shapes;
+}
+
+template<Precision P>
+static void reportTier(const char* name, const std::vector<SupershapeParams>& shapes, const std::vector<float>& angles) {
+	double maxRelativeError = 0.0;
+
+	for (const SupershapeParams& shape : shapes) {
+		for (float angle : angles) {
+			double exact = supershapeRadius<Precision::Exact>((double)angle, shape);
+			double approximate = supershapeRadius<P>(angle, shape);
+
+			if (std::isfinite(exact) && exact > 0.0) {
+				maxRelativeError = std::max(maxRelativeError, std::abs(approximate - exact) / exact);
+			}
+		}
+	}
+
+	// Throughput on one thread, filling a row of radii at a time as mesh and analytics code does - with no libm calls in
+	// the way, the approximate tiers can vectorise across the row
+	const int repeats = 20;
+	std::vector<float> radii(angles.size());
+	float sum = 0.0f;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (int repeat = 0; repeat < repeats; repeat++) {
+		for (const SupershapeParams& shape : shapes) {
+			for (size_t i = 0; i < angles.size(); i++) {
+				radii[i] = supershapeRadius<P>(angles[i], shape);
+			}
+
+			sum += radii[repeat];
+		}
+	}
+
+	float seconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+	double evaluations = (double)repeats * shapes.size() * angles.size();
+
+	// Stored where the compiler must assume it is read, so the loop above can't be removed as dead
+	volatile float sink = sum;
+	(void)sink;
+
+	LogLine(LogLevel::Info) << name << ": max relative error " << maxRelativeError << ", " << evaluations / seconds / 1e6 << " M radii/s";
+}
+
+void reportPrecisionTiers() {
+	std::vector<SupershapeParams> shapes = sampleShapes();
+	std::vector<float> angles;
+
+	const float pi = 3.14159265358979f;
+
+	for (int i = 0; i <= 4096; i++) {
+		angles.push_back(-pi + 2.0f * pi * i / 4096.0f);
+	}
+
+	LogLine(LogLevel::Info) << "Supershape radius over " << shapes.size() << " shapes x " << angles.size() << " angles, single precision:";
+
+	reportTier<Precision::Exact>("Exact", shapes, angles);
+	reportTier<Precision::Fast>("Fast", shapes, angles);
+	reportTier<Precision::Fastest>("Fastest", shapes, angles);
+}
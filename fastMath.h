@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/*
+Precision tiers for the transcendentals the superformula spends its time in. shader.vert has the same approximations,
+selected by its PRECISION specialisation constant (the enum's value).
+
+Fast and Fastest use range reduction plus minimax polynomials (Remez-fitted), and pow(b, e) = exp2(e * log2(b)).
+Maximum errors of the polynomials over their reduced ranges:
+
+             sin (relative)   log2 (absolute)   exp2 (relative)   atan (absolute)   asin (absolute)
+ Fast        5.3e-9           5.5e-7            7.5e-8            2.2e-6            2.1e-8
+ Fastest     1.1e-4           1.7e-4            7.5e-5            1.1e-3            6.6e-5
+
+so below Fast, float rounding (~6e-8) dominates. pow's relative error is about ln(2) * |e| * (log2 error) plus the exp2
+error - the exponent amplifies it, and the default n1 = 0.2 gives e = -5. reportPrecisionTiers() measures what that adds
+up to for the whole supershape, against throughput.
+*/
+
+enum class Precision {
+	Exact = 0,
+	Fast = 1,
+	Fastest = 2
+};
+
+// Branch-free, so loops over them can vectorise (libm calls can't)
+namespace fastMath {
+	const float PI = 3.14159265358979f;
+	const float HALF_PI = 1.57079632679490f;
+
+	// pi split in two, so x - k * pi stays accurate for the larger k (Cody-Waite)
+	const float PI_HIGH = 3.140625f;
+	const float PI_LOW = 9.67653589793e-4f;
+
+	// Nearest integer, without a libm call when SSE4.1 isn't available
+	inline float roundToInteger(float x) {
+		return (float)(int)(x + (x >= 0.0f ? 0.5f : -0.5f));
+	}
+
+	// r in [-pi/2, pi/2]
+	template<Precision P>
+	inline float sinReduced(float r) {
+		float r2 = r * r;
+
+		if constexpr (P == Precision::Fast) {
+			return r * (0.99999999469f + r2 * (-0.16666656684f + r2 * (0.0083330251390f + r2 * (-1.9807418728e-4f + r2 * 2.6019030680e-6f))));
+		}
+		else {
+			return r * (0.99989182126f + r2 * (-0.16596011654f + r2 * 0.0076029033434f));
+		}
+	}
+
+	template<Precision P>
+	inline float sin(float x) {
+		if constexpr (P == Precision::Exact) {
+			return std::sin(x);
+		}
+		else {
+			// sin(x) = (-1)^k sin(r), with r = x - k * pi
+			float k = roundToInteger(x * (1.0f / PI));
+			float r = (x - k * PI_HIGH) - k * PI_LOW;
+			float s = sinReduced<P>(r);
+
+			return ((int)k & 1) ? -s : s;
+		}
+	}
+
+	// Reduced on its own rather than as sin(x + pi/2): that sum rounds away the tiny values near the zeros, which the
+	// superformula's small exponents then blow up (|cos|^0.3 of 4e-8 is 6e-3, not 0)
+	template<Precision P>
+	inline float cos(float x) {
+		if constexpr (P == Precision::Exact) {
+			return std::cos(x);
+		}
+		else {
+			// cos(x) = (-1)^k sin(r), with r = x - (k - 1/2) * pi; (k - 1/2) * PI_HIGH is exact
+			float k = roundToInteger(x * (1.0f / PI) + 0.5f);
+			float offset = k - 0.5f;
+			float r = (x - offset * PI_HIGH) - offset * PI_LOW;
+			float s = sinReduced<P>(r);
+
+			return ((int)k & 1) ? -s : s;
+		}
+	}
+
+	// x > 0: split into exponent and a mantissa m in [1, 2), then log2(m) = t * p(t) with t = m - 1
+	template<Precision P>
+	inline float log2(float x) {
+		if constexpr (P == Precision::Exact) {
+			return std::log2(x);
+		}
+		else {
+			uint32_t bits;
+			std::memcpy(&bits, &x, sizeof(bits));
+
+			float exponent = (float)((int)((bits >> 23) & 0xFF) - 127);
+
+			bits = (bits & 0x007FFFFF) | 0x3F800000;
+			float m;
+			std::memcpy(&m, &bits, sizeof(m));
+
+			float t = m - 1.0f;
+
+			if constexpr (P == Precision::Fast) {
+				return exponent + t * (1.4426738997f + t * (-0.72063170410f + t * (0.47351812105f + t * (-0.32504162789f + t * (0.19210598503f
+					+ t * (-0.077403394507f + t * 0.014778720766f))))));
+			}
+			else {
+				return exponent + t * (1.4389484406f + t * (-0.67715076447f + t * (0.31821322082f + t * -0.080010896934f)));
+			}
+		}
+	}
+
+	// 2^x = 2^i * p(f), with i = floor(x) placed straight into the exponent bits
+	template<Precision P>
+	inline float exp2(float x) {
+		if constexpr (P == Precision::Exact) {
+			return std::exp2(x);
+		}
+		else {
+			// floor(), as truncation of a value that is only negative where the result underflows anyway
+			float whole = (float)(int)(x + 128.0f) - 128.0f;
+			float f = x - whole;
+
+			// Clamped after the split rather than before - saturating near 2^127 instead of overflowing to infinity, and
+			// in a form GCC still vectorises
+			whole = std::max(-126.0f, std::min(whole, 127.0f));
+
+			float p;
+
+			if constexpr (P == Precision::Fast) {
+				p = 0.99999992506f + f * (0.69315307320f + f * (0.24015361705f + f * (0.055826318050f + f * (0.0089893400947f + f * 0.0018775766734f))));
+			}
+			else {
+				p = 0.99992521856f + f * (0.69583354051f + f * (0.22606715539f + f * 0.078024522664f));
+			}
+
+			uint32_t bits = (uint32_t)((int)whole + 127) << 23;
+			float scale;
+			std::memcpy(&scale, &bits, sizeof(scale));
+
+			return p * scale;
+		}
+	}
+
+	// base >= 0, as the superformula only ever raises absolute values
+	template<Precision P>
+	inline float pow(float base, float exponent) {
+		if constexpr (P == Precision::Exact) {
+			return std::pow(base, exponent);
+		}
+		else {
+			float result = exp2<P>(exponent * log2<P>(base));
+
+			return base > 0.0f ? result : (exponent > 0.0f ? 0.0f : INFINITY);
+		}
+	}
+
+	// Reduced to [0, 1] by the octant: atan(a) with a = min / max of |x| and |y|, then reflected back
+	template<Precision P>
+	inline float atan2(float y, float x) {
+		if constexpr (P == Precision::Exact) {
+			return std::atan2(y, x);
+		}
+		else {
+			float ax = std::abs(x);
+			float ay = std::abs(y);
+			float high = ax > ay ? ax : ay;
+			float low = ax > ay ? ay : ax;
+
+			float a = high > 0.0f ? low / high : 0.0f;
+			float s = a * a;
+			float r;
+
+			if constexpr (P == Precision::Fast) {
+				r = a * (0.99999997596f + s * (-0.33332251836f + s * (0.19957728206f + s * (-0.13833401501f + s * (0.090705021720f
+					+ s * (-0.043091381655f + s * 0.0098637986918f))))));
+			}
+			else {
+				r = a * (0.99807414605f + s * (-0.29574362421f + s * 0.083067641559f));
+			}
+
+			r = ay > ax ? HALF_PI - r : r;
+			r = x < 0.0f ? PI - r : r;
+
+			return y < 0.0f ? -r : r;
+		}
+	}
+
+	// asin(x) = pi/2 - sqrt(1 - x) * p(x) on [0, 1], odd-reflected
+	template<Precision P>
+	inline float asin(float x) {
+		if constexpr (P == Precision::Exact) {
+			return std::asin(x);
+		}
+		else {
+			float a = std::abs(x);
+			a = a > 1.0f ? 1.0f : a;
+			float p;
+
+			if constexpr (P == Precision::Fast) {
+				p = 1.5707963268f + a * (-0.21460122215f + a * (0.089022350941f + a * (-0.050462444642f + a * (0.031795417170f
+					+ a * (-0.018531518113f + a * (0.0078060568613f + a * -0.0016117456600f))))));
+			}
+			else {
+				p = 1.5707963100f + a * (-0.21371549012f + a * (0.079577773345f + a * -0.022976421142f));
+			}
+
+			float r = HALF_PI - std::sqrt(1.0f - a) * p;
+
+			return x < 0.0f ? -r : r;
+		}
+	}
+}
+
+// Max error of each tier's supershape radius against Exact over a sweep of shapes, and millions of radii per second
+extern void reportPrecisionTiers();
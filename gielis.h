@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cmath>
+
+#include "struct.h"
+#include "fastMath.h"
+
+/*
+The Gielis superformula, exactly as shader.vert evaluates it - for CPU-side work on the shape (analytics, picking) that
+must agree with what is drawn. Templated on the scalar so analytics can run in double precision, and on the precision tier
+(fastMath.h), which must match the shader's to agree with it. The approximate tiers are single precision only.
+*/
+
+template<Precision P = Precision::Exact, typename T>
+inline T supershapeRadius(T angle, const SupershapeParams& shape) {
+	if constexpr (P == Precision::Exact) {
+		T t1 = std::pow(std::abs((T(1) / shape.a) * std::cos(shape.m * angle / T(4))), (T)shape.n2);
+		T t2 = std::pow(std::abs((T(1) / shape.b) * std::sin(shape.m * angle / T(4))), (T)shape.n3);
+
+		return std::pow(t1 + t2, T(-1) / shape.n1);
+	}
+	else {
+		float t1 = fastMath::pow<P>(std::abs((1.0f / shape.a) * fastMath::cos<P>(shape.m * (float)angle / 4.0f)), shape.n2);
+		float t2 = fastMath::pow<P>(std::abs((1.0f / shape.b) * fastMath::sin<P>(shape.m * (float)angle / 4.0f)), shape.n3);
+
+		return (T)fastMath::pow<P>(t1 + t2, -1.0f / shape.n1);
+	}
+}
+
+// For a tier only known at runtime
+inline float supershapeRadius(float angle, const SupershapeParams& shape, Precision precision) {
+	switch (precision) {
+	case Precision::Fast:
+		return supershapeRadius<Precision::Fast>(angle, shape);
+
+	case Precision::Fastest:
+		return supershapeRadius<Precision::Fastest>(angle, shape);
+
+	default:
+		return supershapeRadius<Precision::Exact>(angle, shape);
+	}
+}
+
+// Longitude theta in [-pi, pi], latitude phi in [-pi/2, pi/2]. The shader divides by rho through w, so this is the shape
+// at unit scale, before the model matrix
+template<Precision P = Precision::Exact, typename T>
+inline void supershapePoint(T theta, T phi, const SupershapeParams& shape, T& x, T& y, T& z) {
+	T r1 = supershapeRadius<P>(theta, shape);
+	T r2 = supershapeRadius<P>(phi, shape);
+
+	x = r1 * std::cos(theta) * r2 * std::cos(phi);
+	y = r1 * std::sin(theta) * r2 * std::cos(phi);
+	z = r2 * std::sin(phi);
+}
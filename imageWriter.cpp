@@ -0,0 +1,187 @@
+#include "imageWriter.h"
+
+#include <algorithm>
+#include <fstream>
+
+void toRgb(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra, std::vector<uint8_t>& rgb) {
+	size_t pixelCount = (size_t)width * height;
+	rgb.resize(pixelCount * 3);
+
+	for (size_t i = 0; i < pixelCount; i++) {
+		const uint8_t* pixel = pixels + i * 4;
+
+		rgb[i * 3 + 0] = bgra ? pixel[2] : pixel[0];
+		rgb[i * 3 + 1] = pixel[1];
+		rgb[i * 3 + 2] = bgra ? pixel[0] : pixel[2];
+	}
+}
+
+void toYuv420(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra, std::vector<uint8_t>& yuv) {
+	uint32_t chromaWidth = (width + 1) / 2;
+	uint32_t chromaHeight = (height + 1) / 2;
+	size_t lumaSize = (size_t)width * height;
+	size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+
+	yuv.resize(lumaSize + chromaSize * 2);
+
+	uint8_t* yPlane = yuv.data();
+	uint8_t* uPlane = yPlane + lumaSize;
+	uint8_t* vPlane = uPlane + chromaSize;
+
+	int redIndex = bgra ? 2 : 0;
+	int blueIndex = bgra ? 0 : 2;
+
+	// Fixed point, 8 fractional bits
+	for (size_t i = 0; i < lumaSize; i++) {
+		const uint8_t* pixel = pixels + i * 4;
+		yPlane[i] = (uint8_t)((77 * pixel[redIndex] + 150 * pixel[1] + 29 * pixel[blueIndex] + 128) >> 8);
+	}
+
+	for (uint32_t cy = 0; cy < chromaHeight; cy++) {
+		for (uint32_t cx = 0; cx < chromaWidth; cx++) {
+			int red = 0;
+			int green = 0;
+			int blue = 0;
+			int count = 0;
+
+			for (uint32_t y = cy * 2; y < std::min(height, cy * 2 + 2); y++) {
+				for (uint32_t x = cx * 2; x < std::min(width, cx * 2 + 2); x++) {
+					const uint8_t* pixel = pixels + ((size_t)y * width + x) * 4;
+					red += pixel[redIndex];
+					green += pixel[1];
+					blue += pixel[blueIndex];
+					count++;
+				}
+			}
+
+			red /= count;
+			green /= count;
+			blue /= count;
+
+			// Offset by 128 << 8 so the shifted values are never negative
+			size_t i = (size_t)cy * chromaWidth + cx;
+			uPlane[i] = (uint8_t)std::min(255, (-43 * red - 85 * green + 128 * blue + 32896) >> 8);
+			vPlane[i] = (uint8_t)std::min(255, (128 * red - 107 * green - 21 * blue + 32896) >> 8);
+		}
+	}
+}
+
+static uint32_t crcTable[256];
+
+static void initCrcTable() {
+	for (uint32_t n = 0; n < 256; n++) {
+		uint32_t c = n;
+
+		for (int k = 0; k < 8; k++) {
+			c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		}
+
+		crcTable[n] = c;
+	}
+}
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+
+	return crc;
+}
+
+static void putBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+	out.push_back((uint8_t)(value >> 24));
+	out.push_back((uint8_t)(value >> 16));
+	out.push_back((uint8_t)(value >> 8));
+	out.push_back((uint8_t)value);
+}
+
+static void writeChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data) {
+	std::vector<uint8_t> header;
+	putBigEndian(header, (uint32_t)data.size());
+	header.insert(header.end(), type, type + 4);
+
+	uint32_t crc = updateCrc(0xFFFFFFFFu, header.data() + 4, 4);
+	crc = updateCrc(crc, data.data(), data.size()) ^ 0xFFFFFFFFu;
+
+	std::vector<uint8_t> footer;
+	putBigEndian(footer, crc);
+
+	file.write(reinterpret_cast<const char*>(header.data()), header.size());
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	file.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+}
+
+bool writePng(const std::string& filename, uint32_t width, uint32_t height, const uint8_t* rgb) {
+	static bool crcReady = (initCrcTable(), true);
+	(void)crcReady;
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	// 8-bit RGB, no interlacing
+	std::vector<uint8_t> ihdr;
+	putBigEndian(ihdr, width);
+	putBigEndian(ihdr, height);
+	ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 });
+	writeChunk(file, "IHDR", ihdr);
+
+	// Each row is prefixed with filter type 0 (none)
+	size_t rowSize = (size_t)width * 3 + 1;
+	std::vector<uint8_t> raw(rowSize * height);
+
+	for (uint32_t y = 0; y < height; y++) {
+		raw[y * rowSize] = 0;
+		std::copy(rgb + (size_t)y * width * 3, rgb + (size_t)(y + 1) * width * 3, raw.begin() + y * rowSize + 1);
+	}
+
+	// zlib stream of stored deflate blocks, at most 65535 bytes each
+	std::vector<uint8_t> idat;
+	idat.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+
+	size_t offset = 0;
+
+	do {
+		size_t blockSize = std::min<size_t>(65535, raw.size() - offset);
+		bool last = offset + blockSize == raw.size();
+
+		idat.push_back(last ? 1 : 0);
+		idat.push_back((uint8_t)blockSize);
+		idat.push_back((uint8_t)(blockSize >> 8));
+		idat.push_back((uint8_t)~blockSize);
+		idat.push_back((uint8_t)(~blockSize >> 8));
+		idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+
+		offset += blockSize;
+	} while (offset < raw.size());
+
+	uint32_t adlerA = 1;
+	uint32_t adlerB = 0;
+
+	// 5552 bytes is the most that can be summed before the 32-bit sums could overflow
+	for (size_t start = 0; start < raw.size(); start += 5552) {
+		size_t end = std::min(raw.size(), start + 5552);
+
+		for (size_t i = start; i < end; i++) {
+			adlerA += raw[i];
+			adlerB += adlerA;
+		}
+
+		adlerA %= 65521;
+		adlerB %= 65521;
+	}
+
+	putBigEndian(idat, (adlerB << 16) | adlerA);
+	writeChunk(file, "IDAT", idat);
+
+	writeChunk(file, "IEND", {});
+
+	return (bool)file;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+Minimal image output with no external dependencies.
+
+PNGs are written with stored (uncompressed) deflate blocks - bigger files, but encoding is a straight copy plus checksums,
+so it never becomes the bottleneck of a render loop.
+*/
+
+// Converts tightly packed 4-byte pixels (RGBA or BGRA order) to tightly packed RGB
+extern void toRgb(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra, std::vector<uint8_t>& rgb);
+
+// Converts tightly packed 4-byte pixels to planar 8-bit YUV 4:2:0 (full range BT.601, chroma averaged over 2x2 blocks),
+// as a Y4M stream with C420jpeg expects. Odd sizes round the chroma planes up
+extern void toYuv420(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra, std::vector<uint8_t>& yuv);
+
+extern bool writePng(const std::string& filename, uint32_t width, uint32_t height, const uint8_t* rgb);
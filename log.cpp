@@ -0,0 +1,225 @@
+#include "log.h"
+#include "ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+const size_t LOG_RING_SIZE = 512;
+const size_t REPEAT_SLOTS = 256;
+const std::chrono::milliseconds DRAIN_INTERVAL(5); // How long the writer sleeps when the ring is empty
+
+struct LogEntry {
+	LogLevel level;
+	std::chrono::steady_clock::time_point time;
+	uint32_t suppressed; // Repeats of this message held back since the last one let through
+	uint32_t length;
+	bool truncated;
+	char text[LOG_MESSAGE_SIZE];
+};
+
+// Count of one message in the current one-second window - anything past LOG_REPEAT_LIMIT was suppressed. Messages whose keys
+// share a slot just reset each other, and producers racing on a slot only let a repeat or two more or fewer through -
+// neither is worth a lock. A cache line each, so threads repeating different messages don't contend
+struct alignas(64) RepeatSlot {
+	std::atomic<uint64_t> key{ 0 };
+	std::atomic<int64_t> second{ -1 };
+	std::atomic<uint32_t> count{ 0 };
+};
+
+class Logger {
+public:
+	Logger() : thread(&Logger::drain, this) {}
+
+	~Logger() {
+		running.store(false, std::memory_order_release);
+		thread.join();
+	}
+
+	bool admit(uint64_t key, int64_t second, uint32_t& suppressed);
+	void drain();
+	bool writeAvailable();
+
+	MpscRing<LogEntry, LOG_RING_SIZE> ring;
+	RepeatSlot repeats[REPEAT_SLOTS];
+
+	std::atomic<int> minimum{ (int)LogLevel::Info };
+	std::atomic<uint64_t> dropped{ 0 };
+	uint64_t reportedDropped = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::atomic<bool> running{ true };
+
+	std::thread thread; // Last, so everything it uses is constructed before it starts
+};
+
+// Started on first use, stopped (after writing out whatever is left) at exit
+static Logger& logger() {
+	static Logger instance;
+	return instance;
+}
+
+bool Logger::admit(uint64_t key, int64_t second, uint32_t& suppressed) {
+	RepeatSlot& slot = repeats[(key * 0x9E3779B97F4A7C15ull) >> 56 & (REPEAT_SLOTS - 1)];
+	suppressed = 0;
+
+	if (slot.key.load(std::memory_order_relaxed) != key) {
+		slot.key.store(key, std::memory_order_relaxed);
+		slot.second.store(second, std::memory_order_relaxed);
+		slot.count.store(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	if (slot.second.load(std::memory_order_relaxed) != second) {
+		slot.second.store(second, std::memory_order_relaxed);
+		uint32_t previous = slot.count.exchange(1, std::memory_order_relaxed);
+		suppressed = previous > LOG_REPEAT_LIMIT ? previous - LOG_REPEAT_LIMIT : 0;
+		return true;
+	}
+
+	return slot.count.fetch_add(1, std::memory_order_relaxed) < LOG_REPEAT_LIMIT;
+}
+
+// Returns whether anything was written
+bool Logger::writeAvailable() {
+	bool wroteOut = false;
+	bool wroteErr = false;
+
+	auto write = [&](LogEntry& entry) {
+		const char tags[] = { 'D', 'I', 'W', 'E' };
+		double seconds = std::chrono::duration<double>(entry.time - start).count();
+
+		char prefix[32];
+		int prefixLength = std::snprintf(prefix, sizeof(prefix), "[%10.3f %c] ", seconds, tags[(int)entry.level]);
+
+		bool error = entry.level >= LogLevel::Warning;
+		std::ostream& out = error ? std::cerr : std::cout;
+
+		out.write(prefix, prefixLength);
+		out.write(entry.text, entry.length);
+
+		if (entry.truncated) {
+			out << "...";
+		}
+
+		if (entry.suppressed > 0) {
+			out << " (" << entry.suppressed << " repeats suppressed)";
+		}
+
+		out.put('\n');
+
+		wroteOut |= !error;
+		wroteErr |= error;
+	};
+
+	while (ring.pop(write)) {}
+
+	uint64_t droppedNow = dropped.load(std::memory_order_relaxed);
+
+	if (droppedNow != reportedDropped) {
+		std::cerr << "Log: " << droppedNow - reportedDropped << " lines dropped with the ring full\n";
+		reportedDropped = droppedNow;
+		wroteErr = true;
+	}
+
+	// Once per batch instead of once per line
+	if (wroteOut) {
+		std::cout.flush();
+	}
+
+	if (wroteErr) {
+		std::cerr.flush();
+	}
+
+	return wroteOut || wroteErr;
+}
+
+void Logger::drain() {
+	while (running.load(std::memory_order_acquire)) {
+		if (!writeAvailable()) {
+			std::this_thread::sleep_for(DRAIN_INTERVAL);
+		}
+	}
+
+	writeAvailable();
+}
+
+void setLogLevel(LogLevel level) {
+	logger().minimum.store((int)level, std::memory_order_relaxed);
+}
+
+bool logEnabled(LogLevel level) {
+	return (int)level >= logger().minimum.load(std::memory_order_relaxed);
+}
+
+void logMessage(LogLevel level, const char* text, size_t length, uint64_t key) {
+	Logger& log = logger();
+
+	if ((int)level < log.minimum.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+
+	while (length > 0 && text[length - 1] == '\n') {
+		length--;
+	}
+
+	// FNV-1a
+	if (key == 0) {
+		key = 0xCBF29CE484222325ull;
+
+		for (size_t i = 0; i < length; i++) {
+			key = (key ^ (uint8_t)text[i]) * 0x100000001B3ull;
+		}
+	}
+
+	uint32_t suppressed;
+	int64_t second = std::chrono::duration_cast<std::chrono::seconds>(now - log.start).count();
+
+	if (!log.admit(key, second, suppressed)) {
+		return;
+	}
+
+	bool pushed = log.ring.push([&](LogEntry& entry) {
+		entry.level = level;
+		entry.time = now;
+		entry.suppressed = suppressed;
+		entry.truncated = length >= LOG_MESSAGE_SIZE;
+		entry.length = (uint32_t)std::min(length, LOG_MESSAGE_SIZE);
+		std::memcpy(entry.text, text, entry.length);
+	});
+
+	if (!pushed) {
+		log.dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void logMessage(LogLevel level, const char* text) {
+	logMessage(level, text, std::strlen(text));
+}
+
+void flushLog() {
+	Logger& log = logger();
+	size_t target = log.ring.pushedCount();
+
+	while (log.ring.poppedCount() < target) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+uint64_t droppedLogLines() {
+	return logger().dropped.load(std::memory_order_relaxed);
+}
+
+LogLine::LogLine(LogLevel level) : level(level), enabled(logEnabled(level)), buffer(text, LOG_MESSAGE_SIZE), stream(&buffer) {}
+
+LogLine::~LogLine() {
+	if (enabled) {
+		logMessage(level, text, buffer.length());
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+
+/*
+Non-blocking logging. Any thread copies its line, with a timestamp, into a cell of a lock-free ring (ring.h) and returns; a
+background thread drains the ring to stdout (Debug, Info) or stderr (Warning, Error), flushing once per batch. A producer's
+cost is a clock read, a copy of the text and one compare-and-swap, so the Vulkan validation callback no longer stalls the
+driver thread that called it.
+
+Lines below the level set with setLogLevel() are dropped before any formatting. The same message (by key, or by a hash of its
+text) is let through at most LOG_REPEAT_LIMIT times a second; the next one through after a quiet spell says how many were
+suppressed. If the ring is full, lines are dropped and counted rather than waited for.
+*/
+
+enum class LogLevel {
+	Debug = 0,
+	Info = 1,
+	Warning = 2,
+	Error = 3
+};
+
+const size_t LOG_MESSAGE_SIZE = 1024; // Longer lines are truncated
+const uint32_t LOG_REPEAT_LIMIT = 10; // Per message, per second
+
+extern void setLogLevel(LogLevel level);
+extern bool logEnabled(LogLevel level);
+
+// text needn't be null-terminated. key identifies repeats of one message (0 hashes the text instead)
+extern void logMessage(LogLevel level, const char* text, size_t length, uint64_t key = 0);
+extern void logMessage(LogLevel level, const char* text);
+
+// Blocks until every line logged before the call has been written out
+extern void flushLog();
+
+// Lines dropped so far because the ring was full
+extern uint64_t droppedLogLines();
+
+/*
+Stream-style formatting into a fixed buffer, submitted when the temporary dies:
+
+	LogLine(LogLevel::Info) << "Detail " << detail << " live";
+
+No heap allocation, and nothing is formatted when the level is filtered out.
+*/
+class LogLine {
+public:
+	explicit LogLine(LogLevel level);
+	~LogLine();
+
+	LogLine(const LogLine&) = delete;
+	LogLine& operator=(const LogLine&) = delete;
+
+	template<typename T>
+	LogLine& operator<<(const T& value) {
+		if (enabled) {
+			stream << value;
+		}
+
+		return *this;
+	}
+
+	// Manipulators such as std::setw are handled by the template above; std::fixed and friends are functions
+	LogLine& operator<<(std::ios_base& (*manipulator)(std::ios_base&)) {
+		if (enabled) {
+			stream << manipulator;
+		}
+
+		return *this;
+	}
+
+private:
+	// Writes into text, silently truncating at the end
+	class Buffer : public std::streambuf {
+	public:
+		Buffer(char* begin, size_t size) {
+			setp(begin, begin + size);
+		}
+
+		size_t length() const {
+			return pptr() - pbase();
+		}
+	};
+
+	LogLevel level;
+	bool enabled;
+
+	char text[LOG_MESSAGE_SIZE];
+	Buffer buffer;
+	std::ostream stream;
+};
@@ -0,0 +1,31 @@
+#include "memoryAccounting.h"
+#include "log.h"
+
+static MemoryCounter hostCounters[(size_t)HostMemory::Count];
+
+MemoryCounter& hostMemory(HostMemory category) {
+	return hostCounters[(size_t)category];
+}
+
+const char* hostMemoryName(HostMemory category) {
+	switch (category) {
+	case HostMemory::Mesh:
+		return "mesh";
+	case HostMemory::Picking:
+		return "picking";
+	default:
+		return "unknown";
+	}
+}
+
+void reportHostMemory() {
+	LogLine line(LogLevel::Info);
+	line << "Host memory:";
+
+	for (size_t i = 0; i < (size_t)HostMemory::Count; i++) {
+		const MemoryCounter& counter = hostCounters[i];
+
+		line << (i > 0 ? "," : "") << " " << hostMemoryName((HostMemory)i) << " " << counter.getCurrent() / 1024 << " KiB (peak "
+			<< counter.getPeak() / 1024 << ")";
+	}
+}
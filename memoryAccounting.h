@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/*
+Host memory accounting, per subsystem. Only the containers that grow with the detail level are counted - at detail 1024 they
+are tens of megabytes, everything else the app allocates is noise next to them. A container opts in by using a
+CountingAllocator (usually through TrackedVector); counting costs two relaxed atomic operations per allocation, nothing per
+element.
+*/
+
+enum class HostMemory {
+	Mesh, // Generated meshes, until they have been handed to the uploader
+	Picking, // The picking BVH and its build scratch
+	Count
+};
+
+// Current and peak bytes, updated from any thread
+struct MemoryCounter {
+	std::atomic<int64_t> current{ 0 };
+	std::atomic<int64_t> peak{ 0 };
+
+	void add(int64_t bytes) {
+		int64_t now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		int64_t previous = peak.load(std::memory_order_relaxed);
+
+		while (now > previous && !peak.compare_exchange_weak(previous, now, std::memory_order_relaxed)) {}
+	}
+
+	void remove(int64_t bytes) {
+		current.fetch_sub(bytes, std::memory_order_relaxed);
+	}
+
+	int64_t getCurrent() const { return current.load(std::memory_order_relaxed); }
+	int64_t getPeak() const { return peak.load(std::memory_order_relaxed); }
+};
+
+extern MemoryCounter& hostMemory(HostMemory category);
+extern const char* hostMemoryName(HostMemory category);
+
+// One line with the current and peak usage of every category
+extern void reportHostMemory();
+
+// Alignment: of every allocation, e.g. 64 to start arrays on a cache line
+template<typename T, HostMemory Category, size_t Alignment = alignof(T)>
+struct CountingAllocator {
+	using value_type = T;
+
+	// Spelled out - the default rebind only works for allocators with nothing but type parameters
+	template<typename U>
+	struct rebind {
+		using other = CountingAllocator<U, Category, Alignment>;
+	};
+
+	CountingAllocator() = default;
+
+	template<typename U>
+	CountingAllocator(const CountingAllocator<U, Category, Alignment>&) {}
+
+	T* allocate(size_t count) {
+		T* memory = static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+		hostMemory(Category).add((int64_t)(count * sizeof(T)));
+
+		return memory;
+	}
+
+	void deallocate(T* memory, size_t count) {
+		hostMemory(Category).remove((int64_t)(count * sizeof(T)));
+		::operator delete(memory, std::align_val_t(Alignment));
+	}
+};
+
+template<typename T, typename U, HostMemory Category, size_t Alignment>
+bool operator==(const CountingAllocator<T, Category, Alignment>&, const CountingAllocator<U, Category, Alignment>&) { return true; }
+
+template<typename T, typename U, HostMemory Category, size_t Alignment>
+bool operator!=(const CountingAllocator<T, Category, Alignment>&, const CountingAllocator<U, Category, Alignment>&) { return false; }
+
+template<typename T, HostMemory Category>
+using TrackedVector = std::vector<T, CountingAllocator<T, Category>>;
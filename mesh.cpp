@@ -0,0 +1,165 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+float map(float value, float a1, float b1, float a2, float b2) {
+	if (a1 > value) {
+		throw std::runtime_error("Value cannot be outside first range!");
+	}
+	else if (b1 < a1 || b2 < a2) {
+		throw std::runtime_error("Second element of range must be greater than first!");
+	}
+
+	float range1 = b1 - a1;
+	float range2 = b2 - a2;
+
+	return a2 + (value - a1) * range2 / range1;
+}
+
+static const glm::vec3 colours[] = {
+	{1.0f, 0.0f, 0.0f}, // RED
+	{1.0f, 0.5f, 0.0f}, // ORANGE
+	{1.0f, 1.0f, 0.0f}, // YELLOW
+	{0.0f, 1.0f, 0.0f}, // GREEN
+	{0.0f, 0.0f, 1.0f}, // BLUE
+	{0.58f, 0.0f, 0.83f} // VIOLET
+};
+
+static uint32_t IX(size_t ringWidth, size_t i, size_t j) {
+	return static_cast<uint32_t>(i * ringWidth + j);
+}
+
+uint32_t sectorCount(size_t detail, uint32_t requested) {
+	return (uint32_t)std::gcd((size_t)std::max(requested, 1u), 2 * detail);
+}
+
+void Mesh::resizeVertices(size_t count) {
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	r.resize(count);
+	g.resize(count);
+	b.resize(count);
+}
+
+// Every ring is the same circle, scaled and lifted - so the trigonometry is per column and per ring, and the inner loop is
+// a multiply per component that vectorises
+Mesh generateMesh(size_t detail, float radius, uint32_t sectors) {
+	Mesh mesh;
+	mesh.detail = detail;
+	mesh.sectors = sectors;
+	mesh.sectorColumns = (uint32_t)(2 * detail / sectors);
+
+	// The whole grid wraps around to its first column; a sector keeps its closing column, shared with the next instance
+	size_t columns = sectors == 1 ? 2 * detail : mesh.sectorColumns + 1;
+
+	mesh.resizeVertices((detail + 1) * columns);
+	mesh.indices.reserve(detail * mesh.sectorColumns * 6);
+
+	std::vector<double> columnX(columns);
+	std::vector<double> columnY(columns);
+
+	for (size_t j = 0; j < columns; j++) {
+		float theta = map((float)j, 0.0f, 2.0f * (float)detail, -glm::pi<float>(), glm::pi<float>());
+
+		columnX[j] = radius * cos(theta);
+		columnY[j] = radius * sin(theta);
+	}
+
+	for (size_t i = 0; i < detail + 1; i++) {
+		float phi = map((float)i, 0.0f, (float)detail, -0.5f * glm::pi<float>(), 0.5f * glm::pi<float>());
+		double ringScale = cos(phi);
+		float z = (float)(radius * sin(phi));
+		glm::vec3 colour = colours[(i / 2) % (sizeof(colours) / sizeof(glm::vec3))];
+
+		size_t row = i * columns;
+
+		for (size_t j = 0; j < columns; j++) {
+			mesh.x[row + j] = (float)(columnX[j] * ringScale);
+			mesh.y[row + j] = (float)(columnY[j] * ringScale);
+			mesh.z[row + j] = z;
+			mesh.r[row + j] = colour.x;
+			mesh.g[row + j] = colour.y;
+			mesh.b[row + j] = colour.z;
+		}
+	}
+
+	for (size_t i = 0; i < detail; i++) {
+		for (size_t j = 0; j < mesh.sectorColumns; j++) {
+			uint32_t bottomLeft = IX(columns, i, j);
+			uint32_t bottomRight = IX(columns, i, (j + 1) % columns);
+			uint32_t topLeft = IX(columns, i + 1, j);
+			uint32_t topRight = IX(columns, i + 1, (j + 1) % columns);
+
+			uint32_t triangleIndices[] = {
+				// Triangle #1
+				bottomLeft, bottomRight, topLeft,
+				// Triangle #2
+				bottomRight, topRight, topLeft
+			};
+
+			for (uint32_t index : triangleIndices) {
+				mesh.indices.push_back(index);
+			}
+		}
+	}
+
+	return mesh;
+}
+
+static_assert(sizeof(Vertex) == 6 * sizeof(float) && offsetof(Vertex, colour) == 3 * sizeof(float), "interleaveVertices() assumes a packed Vertex!");
+
+void interleaveVertices(const Mesh& mesh, size_t first, size_t count, Vertex* out) {
+	const float* x = mesh.x.data() + first;
+	const float* y = mesh.y.data() + first;
+	const float* z = mesh.z.data() + first;
+	const float* r = mesh.r.data() + first;
+	const float* g = mesh.g.data() + first;
+	const float* b = mesh.b.data() + first;
+
+	float* destination = reinterpret_cast<float*>(out);
+	size_t i = 0;
+
+#if defined(__SSE__) || defined(_M_X64)
+	// Four vertices at a time: transpose x, y, z, r into one vertex per register, then splice g and b in between. Six
+	// unaligned stores write 96 contiguous bytes, which suits write-combined staging memory
+	for (; i + 4 <= count; i += 4) {
+		__m128 v0 = _mm_loadu_ps(x + i);
+		__m128 v1 = _mm_loadu_ps(y + i);
+		__m128 v2 = _mm_loadu_ps(z + i);
+		__m128 v3 = _mm_loadu_ps(r + i);
+		_MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+
+		__m128 gb01 = _mm_unpacklo_ps(_mm_loadu_ps(g + i), _mm_loadu_ps(b + i));
+		__m128 gb23 = _mm_unpackhi_ps(_mm_loadu_ps(g + i), _mm_loadu_ps(b + i));
+
+		float* vertex = destination + i * 6;
+
+		_mm_storeu_ps(vertex + 0, v0);
+		_mm_storeu_ps(vertex + 4, _mm_movelh_ps(gb01, v1));
+		_mm_storeu_ps(vertex + 8, _mm_movehl_ps(gb01, v1));
+		_mm_storeu_ps(vertex + 12, v2);
+		_mm_storeu_ps(vertex + 16, _mm_movelh_ps(gb23, v3));
+		_mm_storeu_ps(vertex + 20, _mm_movehl_ps(gb23, v3));
+	}
+#endif
+
+	for (; i < count; i++) {
+		float* vertex = destination + i * 6;
+
+		vertex[0] = x[i];
+		vertex[1] = y[i];
+		vertex[2] = z[i];
+		vertex[3] = r[i];
+		vertex[4] = g[i];
+		vertex[5] = b[i];
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "struct.h"
+#include "allocator.h"
+#include "memoryAccounting.h"
+
+/*
+The sphere the supershape is displaced from (in shader.vert): detail + 1 rings of latitude from pole to pole, each with
+2 * detail vertices around, wrapping back to the first vertex of the ring.
+
+Generation is a pure function of (detail, radius), so it can run on a worker thread while the old mesh is still drawn.
+
+With sectors > 1 only the first of that many equal slices of the grid around the z axis is generated and stored, and it is
+drawn as one instance per sector - shader.vert rotates each into place. The displacement into the supershape happens in
+the shader, after the rotation, so this is exact for any shape (including a non-integer or animated m): the sphere has
+every rotational symmetry. Memory and generation time fall by the sector count.
+
+On the CPU a mesh is a structure of arrays - one array per component, each starting on a cache line - so a pass over
+positions reads only positions and vectorises cleanly. interleaveVertices() builds the GPU layout (Vertex) at upload time,
+straight into staging memory.
+*/
+
+const size_t MESH_ALIGNMENT = 64;
+
+template<typename T>
+using MeshArray = std::vector<T, CountingAllocator<T, HostMemory::Mesh, MESH_ALIGNMENT>>;
+
+struct Mesh {
+	size_t detail = 0;
+	uint32_t sectors = 1;
+	uint32_t sectorColumns = 0; // Quads around each ring of a sector
+
+	MeshArray<float> x;
+	MeshArray<float> y;
+	MeshArray<float> z;
+
+	MeshArray<float> r;
+	MeshArray<float> g;
+	MeshArray<float> b;
+
+	TrackedVector<uint32_t, HostMemory::Mesh> indices; // 32-bit - 16-bit indices run out above detail 180
+
+	size_t vertexCount() const { return x.size(); }
+	void resizeVertices(size_t count);
+};
+
+// One half of the double-buffered geometry: vertices followed by indices in a single buffer
+struct GeometrySlot {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	Allocation allocation;
+
+	size_t detail = 0;
+	VkDeviceSize indexOffset = 0;
+	uint32_t indexCount = 0;
+
+	uint32_t sectors = 1; // Instances to draw
+	uint32_t sectorColumns = 0;
+
+	VkDeviceSize size = 0;
+	VkDeviceSize uploadedBytes = 0; // How much has been handed to the uploader so far
+	uint64_t uploadValue = 0; // Upload timeline value the contents are valid at
+};
+
+// Detail is capped so vertex indices stay within the guaranteed maxDrawIndexedIndexValue (2^24 - 1)
+const size_t MIN_DETAIL = 8;
+const size_t MAX_DETAIL = 1024;
+
+float map(float value, float a1, float b1, float a2, float b2);
+
+// The largest divisor of requested that also divides the grid's 2 * detail columns, so every sector is the same
+uint32_t sectorCount(size_t detail, uint32_t requested);
+
+Mesh generateMesh(size_t detail, float radius, uint32_t sectors = 1);
+
+// Writes vertices [first, first + count) of the mesh to out in the Vertex layout
+void interleaveVertices(const Mesh& mesh, size_t first, size_t count, Vertex* out);
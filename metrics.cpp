@@ -0,0 +1,202 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint32_t currentProcessId() {
+#ifdef _WIN32
+	return (uint32_t)GetCurrentProcessId();
+#else
+	return (uint32_t)getpid();
+#endif
+}
+
+std::string metricsBlockName(const char* base, uint32_t processId) {
+	return std::string(base) + "-" + std::to_string(processId);
+}
+
+MetricsBlock* mapMetricsBlock(const char* name, bool create) {
+#ifdef _WIN32
+	std::string mappingName = std::string("Local\\") + (name[0] == '/' ? name + 1 : name);
+	HANDLE mapping;
+
+	if (create) {
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(MetricsBlock), mappingName.c_str());
+	}
+	else {
+		mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName.c_str());
+	}
+
+	if (mapping == nullptr) {
+		return nullptr;
+	}
+
+	// The view keeps the mapping alive. Mapping more than a smaller object holds fails, so there is no size to check
+	void* view = MapViewOfFile(mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, sizeof(MetricsBlock));
+	CloseHandle(mapping);
+
+	return static_cast<MetricsBlock*>(view);
+#else
+	int file = shm_open(name, create ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+
+	if (file < 0) {
+		return nullptr;
+	}
+
+	void* view = MAP_FAILED;
+	struct stat existing;
+
+	// Reading past the end of a shorter object would be SIGBUS, not an error
+	bool sized = create ? ftruncate(file, sizeof(MetricsBlock)) == 0 : fstat(file, &existing) == 0 && (size_t)existing.st_size >= sizeof(MetricsBlock);
+
+	if (sized) {
+		view = mmap(nullptr, sizeof(MetricsBlock), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+	}
+
+	// The mapping keeps the memory alive
+	::close(file);
+
+	if (view == MAP_FAILED) {
+		// Don't leave a name behind that readers would find but could never trust
+		if (create) {
+			shm_unlink(name);
+		}
+
+		return nullptr;
+	}
+
+	return static_cast<MetricsBlock*>(view);
+#endif
+}
+
+void unmapMetricsBlock(MetricsBlock* block, const char* name, bool remove) {
+#ifdef _WIN32
+	UnmapViewOfFile(block);
+#else
+	munmap(block, sizeof(MetricsBlock));
+
+	if (remove) {
+		shm_unlink(name);
+	}
+#endif
+}
+
+bool readMetrics(const MetricsBlock* block, MetricsData& data) {
+	for (int attempt = 0; attempt < 1000; attempt++) {
+		uint32_t before = block->sequence.load(std::memory_order_acquire);
+
+		if (before & 1) {
+			continue;
+		}
+
+		std::memcpy(&data, &block->data, sizeof(MetricsData));
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (block->sequence.load(std::memory_order_relaxed) == before) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool MetricsPublisher::open(const char* base) {
+	name = metricsBlockName(base, currentProcessId());
+	block = mapMetricsBlock(name.c_str(), true);
+
+	if (block == nullptr) {
+		return false;
+	}
+
+	// Only a crashed run with the same process id can have left a block here - it is simply taken over
+	block->sequence.store(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	block->version = METRICS_VERSION;
+	block->size = sizeof(MetricsBlock);
+	block->processId = currentProcessId();
+	std::memset(&block->data, 0, sizeof(MetricsData));
+
+	// Magic last, so a reader that sees it sees a complete header
+	std::atomic_thread_fence(std::memory_order_release);
+	block->magic = METRICS_MAGIC;
+	block->sequence.store(2, std::memory_order_release);
+
+	return true;
+}
+
+void MetricsPublisher::close() {
+	if (block == nullptr) {
+		return;
+	}
+
+	unmapMetricsBlock(block, name.c_str(), true);
+	block = nullptr;
+}
+
+// Removes the value leaving the window and inserts the new one, keeping sorted in order - a memmove of at most the window,
+// instead of sorting it every frame
+static void updateSortedWindow(float* sorted, size_t held, float evicted, float added) {
+	if (held == METRICS_WINDOW) {
+		float* old = std::lower_bound(sorted, sorted + held, evicted);
+		std::copy(old + 1, sorted + held, old);
+		held--;
+	}
+
+	float* position = std::upper_bound(sorted, sorted + held, added);
+	std::copy_backward(position, sorted + held, sorted + held + 1);
+	*position = added;
+}
+
+void MetricsPublisher::publish(float frameMs, float fenceWaitMs, MetricsData& data) {
+	if (block == nullptr) {
+		return;
+	}
+
+	size_t slot = recorded % METRICS_WINDOW;
+	size_t held = std::min(recorded, METRICS_WINDOW);
+
+	updateSortedWindow(sortedFrameTimes, held, frameTimes[slot], frameMs);
+	updateSortedWindow(sortedFenceWaits, held, fenceWaits[slot], fenceWaitMs);
+
+	frameTimes[slot] = frameMs;
+	fenceWaits[slot] = fenceWaitMs;
+	recorded++;
+
+	size_t count = std::min(recorded, METRICS_WINDOW);
+
+	auto percentile = [&](const float* sorted, float fraction) {
+		return sorted[std::min(count - 1, (size_t)(fraction * (float)count))];
+	};
+
+	data.updateTimeNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	data.frameMs = frameMs;
+	data.frameMsP50 = percentile(sortedFrameTimes, 0.5f);
+	data.frameMsP95 = percentile(sortedFrameTimes, 0.95f);
+	data.frameMsP99 = percentile(sortedFrameTimes, 0.99f);
+	data.frameMsMax = sortedFrameTimes[count - 1];
+	data.fenceWaitMs = fenceWaitMs;
+	data.fenceWaitMsP99 = percentile(sortedFenceWaits, 0.99f);
+
+	uint32_t sequence = block->sequence.load(std::memory_order_relaxed);
+
+	block->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	std::memcpy(&block->data, &data, sizeof(MetricsData));
+
+	block->sequence.store(sequence + 2, std::memory_order_release);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+Live metrics in a named shared memory block, for monitoring agents on the same machine (tools/metricsReader.cpp is a minimal
+one). The layout is fixed and versioned - readers check magic, version and size before trusting anything else.
+
+The block is a seqlock: the writer makes the sequence odd, updates the data, then makes it even again. A reader copies the
+data between two reads of the sequence and retries if either was odd or they differ, so it never sees a torn update and the
+writer never waits for it. Publishing is a handful of stores into already-mapped memory - no syscalls.
+
+Each writer appends its process id to the name ("/supersphere-metrics-1234"), so several instances on one machine never share
+a block. Readers are given the name or the process id.
+
+Windows uses a named file mapping ("Local\" + name without the leading slash) instead of POSIX shm_open.
+*/
+
+const uint32_t METRICS_MAGIC = 0x314D5353; // "SSM1"
+const uint32_t METRICS_VERSION = 1;
+const size_t METRICS_WINDOW = 256; // Frames the percentiles cover
+
+// Any change here must bump METRICS_VERSION
+struct MetricsData {
+	uint64_t frameCount;
+	uint64_t updateTimeNs; // std::chrono::steady_clock (CLOCK_MONOTONIC on Linux), comparable across processes
+
+	// CPU frame time, loop start to present, over the last METRICS_WINDOW frames drawn
+	float frameMs;
+	float frameMsP50;
+	float frameMsP95;
+	float frameMsP99;
+	float frameMsMax;
+
+	// Time blocked on the frame-in-flight fence
+	float fenceWaitMs;
+	float fenceWaitMsP99;
+
+	uint32_t presentMode; // VkPresentModeKHR
+	uint32_t detail;
+	uint32_t width;
+	uint32_t height;
+	uint32_t deviceAllocations; // Live vkAllocateMemory allocations
+
+	uint64_t vertexCount; // Drawn, over every sector instance
+	uint64_t indexCount;
+	uint64_t deviceMemoryReserved; // Bytes allocated from the driver
+	uint64_t deviceMemoryUsed; // Bytes of that handed out to resources
+};
+
+struct MetricsBlock {
+	// Written once, before anything else
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; // sizeof(MetricsBlock)
+	uint32_t processId;
+
+	std::atomic<uint32_t> sequence; // Odd while the data is being written
+	uint32_t reserved;
+
+	MetricsData data;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "The sequence must be lock-free to work across processes!");
+static_assert(sizeof(MetricsData) == 96 && sizeof(MetricsBlock) == 120, "The shared layout must not depend on the compiler!");
+
+// <base>-<process id>, the name a writer with that process id publishes under
+extern std::string metricsBlockName(const char* base, uint32_t processId);
+
+// Maps the named block, creating it for the writer. Null on failure, or for a reader if the object is too small to be one
+extern MetricsBlock* mapMetricsBlock(const char* name, bool create);
+extern void unmapMetricsBlock(MetricsBlock* block, const char* name, bool remove);
+
+// Copies a consistent snapshot of the data; false if the writer kept it busy for every attempt
+extern bool readMetrics(const MetricsBlock* block, MetricsData& data);
+
+// Closes the block when destroyed, so an exception that unwinds past the owner still removes it
+class MetricsPublisher {
+public:
+	MetricsPublisher() = default;
+	MetricsPublisher(const MetricsPublisher&) = delete;
+	MetricsPublisher& operator=(const MetricsPublisher&) = delete;
+	~MetricsPublisher() { close(); }
+
+	// Publishes as metricsBlockName(base, this process)
+	bool open(const char* base);
+	void close();
+
+	bool isOpen() const { return block != nullptr; }
+	const std::string& getName() const { return name; }
+
+	// Adds the frame to the percentile windows, then publishes data with the frame-time fields filled in
+	void publish(float frameMs, float fenceWaitMs, MetricsData& data);
+
+private:
+	std::string name;
+	MetricsBlock* block = nullptr;
+
+	// In arrival order (a ring), and the same values kept sorted for the percentiles
+	float frameTimes[METRICS_WINDOW];
+	float fenceWaits[METRICS_WINDOW];
+	float sortedFrameTimes[METRICS_WINDOW];
+	float sortedFenceWaits[METRICS_WINDOW];
+	size_t recorded = 0;
+};
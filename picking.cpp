@@ -0,0 +1,515 @@
+#include "picking.h"
+#include "gielis.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <thread>
+
+const uint32_t LEAF_SIZE = 4;
+const uint32_t SAH_BINS = 16;
+const uint32_t PARALLEL_RANGE = 1 << 15; // Subtrees over fewer triangles than this are built on the current thread
+const float REBUILD_COST_RATIO = 1.5f; // Rebuild instead of refit once the tree is this much costlier than when built
+
+float SurfaceBvh::Bounds::area() const {
+	glm::vec3 extent = max - min;
+
+	if (extent.x < 0.0f) {
+		return 0.0f;
+	}
+
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+// Separable, like the shader's formula - r1 per column and r2 per row, so only O(detail) pow() calls. Each angle is recovered
+// from the sphere vertex the way shader.vert does it: the ring scale cos(phi) cancels out of atan2, so one row's worth of
+// columns stands for them all. With sectors, the shader takes theta straight from the grid column instead
+template<Precision P>
+void SurfaceBvh::computePositionsIn() {
+	const float pi = glm::pi<float>();
+
+	size_t columns = 2 * detail;
+	size_t rows = detail + 1;
+
+	std::vector<float> columnX(columns);
+	std::vector<float> columnY(columns);
+
+	for (size_t j = 0; j < columns; j++) {
+		float theta = map((float)j, 0.0f, 2.0f * (float)detail, -pi, pi);
+
+		if (sectors == 1) {
+			theta = fastMath::atan2<P>((float)(radius * std::sin(theta)), (float)(radius * std::cos(theta)));
+		}
+
+		float r1 = supershapeRadius<P>(theta, shape);
+
+		columnX[j] = r1 * fastMath::cos<P>(theta);
+		columnY[j] = r1 * fastMath::sin<P>(theta);
+	}
+
+	positions.resize(rows * columns);
+
+	for (size_t i = 0; i < rows; i++) {
+		float gridPhi = map((float)i, 0.0f, (float)detail, -0.5f * pi, 0.5f * pi);
+
+		// The shader divides by its rho, which the mesh radius matches
+		float phi = fastMath::asin<P>((float)(radius * std::sin(gridPhi)) / radius);
+		float r2 = supershapeRadius<P>(phi, shape);
+		float ringScale = r2 * fastMath::cos<P>(phi);
+		float z = r2 * fastMath::sin<P>(phi);
+
+		glm::vec3* row = positions.data() + i * columns;
+
+		for (size_t j = 0; j < columns; j++) {
+			row[j] = glm::vec3(columnX[j] * ringScale, columnY[j] * ringScale, z);
+		}
+	}
+}
+
+void SurfaceBvh::computePositions() {
+	switch (precision) {
+	case Precision::Fast:
+		computePositionsIn<Precision::Fast>();
+		break;
+
+	case Precision::Fastest:
+		computePositionsIn<Precision::Fastest>();
+		break;
+
+	default:
+		computePositionsIn<Precision::Exact>();
+		break;
+	}
+}
+
+void SurfaceBvh::build(const SupershapeParams& shape, size_t detail, Precision precision, float radius, uint32_t sectors) {
+	this->shape = shape;
+	this->detail = detail;
+	this->precision = precision;
+	this->radius = radius;
+	this->sectors = sectors;
+
+	computePositions();
+
+	size_t columns = 2 * detail;
+	uint32_t triangleCount = (uint32_t)(detail * columns * 2);
+
+	triangles.resize(triangleCount * 3);
+
+	for (size_t i = 0; i < detail; i++) {
+		for (size_t j = 0; j < columns; j++) {
+			uint32_t bottomLeft = (uint32_t)(i * columns + j);
+			uint32_t bottomRight = (uint32_t)(i * columns + (j + 1) % columns);
+			uint32_t topLeft = (uint32_t)((i + 1) * columns + j);
+			uint32_t topRight = (uint32_t)((i + 1) * columns + (j + 1) % columns);
+
+			uint32_t* quad = triangles.data() + (i * columns + j) * 6;
+
+			quad[0] = bottomLeft;
+			quad[1] = bottomRight;
+			quad[2] = topLeft;
+			quad[3] = bottomRight;
+			quad[4] = topRight;
+			quad[5] = topLeft;
+		}
+	}
+
+	buildPrimitives.resize(triangleCount);
+
+	for (uint32_t t = 0; t < triangleCount; t++) {
+		BuildPrimitive& primitive = buildPrimitives[t];
+
+		primitive.bounds = Bounds();
+		primitive.bounds.grow(positions[triangles[t * 3 + 0]]);
+		primitive.bounds.grow(positions[triangles[t * 3 + 1]]);
+		primitive.bounds.grow(positions[triangles[t * 3 + 2]]);
+		primitive.centroid = (primitive.bounds.min + primitive.bounds.max) * 0.5f;
+		primitive.triangle = t;
+	}
+
+	// One thread per hardware thread at most: each level of the tree that forks doubles the count
+	parallelDepth = 0;
+
+	while ((1u << parallelDepth) < std::thread::hardware_concurrency()) {
+		parallelDepth++;
+	}
+
+	// Leaves live in their parents, so there are never more nodes than triangles. Left uninitialised, so the pages of the
+	// (usually much smaller) part never used are never touched
+	size_t poolSize = std::max<size_t>(triangleCount, 1);
+	std::unique_ptr<Node[]> nodePool(new Node[poolSize]);
+	hostMemory(HostMemory::Picking).add((int64_t)(poolSize * sizeof(Node)));
+
+	buildNodes = nodePool.get();
+	nodeCount = 1;
+	depth = 0;
+
+	buildRange(0, 0, triangleCount, 0);
+
+	nodes.assign(buildNodes, buildNodes + nodeCount);
+	buildNodes = nullptr;
+
+	nodePool.reset();
+	hostMemory(HostMemory::Picking).remove((int64_t)(poolSize * sizeof(Node)));
+
+	primitives.resize(triangleCount);
+
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		primitives[i] = buildPrimitives[i].triangle;
+	}
+
+	buildPrimitives.clear();
+	buildPrimitives.shrink_to_fit();
+
+	builtCost = cost();
+}
+
+void SurfaceBvh::update(const SupershapeParams& shape) {
+	this->shape = shape;
+
+	computePositions();
+	refit();
+
+	if (cost() > builtCost * REBUILD_COST_RATIO) {
+		build(shape, detail, precision, radius, sectors);
+	}
+}
+
+SurfaceBvh::Bounds SurfaceBvh::rangeBounds(uint32_t first, uint32_t count) const {
+	Bounds bounds;
+
+	for (uint32_t i = first; i < first + count; i++) {
+		bounds.grow(buildPrimitives[i].bounds);
+	}
+
+	return bounds;
+}
+
+void SurfaceBvh::setChild(Node& node, int side, const Bounds& bounds) {
+	node.minX[side] = bounds.min.x;
+	node.minY[side] = bounds.min.y;
+	node.minZ[side] = bounds.min.z;
+	node.maxX[side] = bounds.max.x;
+	node.maxY[side] = bounds.max.y;
+	node.maxZ[side] = bounds.max.z;
+}
+
+// Binned SAH over the longest axis of the centroids; returns how many primitives go left
+uint32_t SurfaceBvh::split(uint32_t first, uint32_t count) {
+	Bounds centroidBounds;
+
+	for (uint32_t i = first; i < first + count; i++) {
+		centroidBounds.grow(buildPrimitives[i].centroid);
+	}
+
+	glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+	// All centroids in one spot - any split is as good as any other
+	if (extent[axis] <= 0.0f) {
+		return count / 2;
+	}
+
+	float binScale = SAH_BINS / extent[axis];
+	float axisMin = centroidBounds.min[axis];
+
+	auto binOf = [&](const BuildPrimitive& primitive) {
+		return std::min(SAH_BINS - 1, (uint32_t)((primitive.centroid[axis] - axisMin) * binScale));
+	};
+
+	Bounds binBounds[SAH_BINS];
+	uint32_t binCounts[SAH_BINS] = {};
+
+	for (uint32_t i = first; i < first + count; i++) {
+		uint32_t bin = binOf(buildPrimitives[i]);
+
+		binBounds[bin].grow(buildPrimitives[i].bounds);
+		binCounts[bin]++;
+	}
+
+	// Sweep from the right for the cost of everything above each plane, then from the left to find the cheapest
+	float rightCosts[SAH_BINS];
+	Bounds right;
+	uint32_t rightCount = 0;
+
+	for (uint32_t b = SAH_BINS - 1; b > 0; b--) {
+		right.grow(binBounds[b]);
+		rightCount += binCounts[b];
+		rightCosts[b] = right.area() * rightCount;
+	}
+
+	Bounds left;
+	uint32_t leftCount = 0;
+	float bestCost = 1e30f;
+	uint32_t bestPlane = SAH_BINS / 2;
+
+	for (uint32_t b = 1; b < SAH_BINS; b++) {
+		left.grow(binBounds[b - 1]);
+		leftCount += binCounts[b - 1];
+
+		float planeCost = left.area() * leftCount + rightCosts[b];
+
+		if (leftCount > 0 && leftCount < count && planeCost < bestCost) {
+			bestCost = planeCost;
+			bestPlane = b;
+		}
+	}
+
+	BuildPrimitive* begin = buildPrimitives.data() + first;
+	BuildPrimitive* middle = std::partition(begin, begin + count, [&](const BuildPrimitive& primitive) { return binOf(primitive) < bestPlane; });
+	uint32_t leftSize = (uint32_t)(middle - begin);
+
+	// Everything on one side (centroids binned together) - fall back to halving
+	if (leftSize == 0 || leftSize == count) {
+		return count / 2;
+	}
+
+	return leftSize;
+}
+
+void SurfaceBvh::buildRange(uint32_t nodeIndex, uint32_t first, uint32_t count, int depth) {
+	uint32_t leftCount = count > 1 ? split(first, count) : count;
+
+	uint32_t ranges[2][2] = {
+		{ first, leftCount },
+		{ first + leftCount, count - leftCount }
+	};
+
+	std::future<void> leftJob;
+
+	for (int side = 0; side < 2; side++) {
+		uint32_t childFirst = ranges[side][0];
+		uint32_t childCount = ranges[side][1];
+
+		// Written before any child is built, and nothing else touches this node, so threads never share one
+		setChild(buildNodes[nodeIndex], side, rangeBounds(childFirst, childCount));
+
+		if (childCount <= LEAF_SIZE) {
+			buildNodes[nodeIndex].child[side] = childFirst;
+			buildNodes[nodeIndex].count[side] = childCount;
+			continue;
+		}
+
+		uint32_t childIndex = (uint32_t)nodeCount.fetch_add(1);
+		int deepest = this->depth.load(std::memory_order_relaxed);
+
+		while (depth + 1 > deepest && !this->depth.compare_exchange_weak(deepest, depth + 1, std::memory_order_relaxed)) {}
+
+		buildNodes[nodeIndex].child[side] = childIndex;
+		buildNodes[nodeIndex].count[side] = 0;
+
+		if (side == 0 && childCount >= PARALLEL_RANGE && depth < parallelDepth) {
+			leftJob = std::async(std::launch::async, &SurfaceBvh::buildRange, this, childIndex, childFirst, childCount, depth + 1);
+		}
+		else {
+			buildRange(childIndex, childFirst, childCount, depth + 1);
+		}
+	}
+
+	if (leftJob.valid()) {
+		leftJob.get();
+	}
+}
+
+// Children always come after their parents in nodes, so walking backwards visits every child before its parent
+void SurfaceBvh::refit() {
+	for (size_t n = nodeCount; n-- > 0;) {
+		Node& node = nodes[n];
+
+		for (int side = 0; side < 2; side++) {
+			Bounds bounds;
+
+			if (node.count[side] > 0) {
+				for (uint32_t i = node.child[side]; i < node.child[side] + node.count[side]; i++) {
+					const uint32_t* triangle = triangles.data() + primitives[i] * 3;
+
+					bounds.grow(positions[triangle[0]]);
+					bounds.grow(positions[triangle[1]]);
+					bounds.grow(positions[triangle[2]]);
+				}
+			}
+			else {
+				const Node& child = nodes[node.child[side]];
+
+				for (int grandchild = 0; grandchild < 2; grandchild++) {
+					bounds.grow(glm::vec3(child.minX[grandchild], child.minY[grandchild], child.minZ[grandchild]));
+					bounds.grow(glm::vec3(child.maxX[grandchild], child.maxY[grandchild], child.maxZ[grandchild]));
+				}
+			}
+
+			setChild(node, side, bounds);
+		}
+	}
+}
+
+// Total SAH cost of the inner boxes, relative to the root's - what a refit makes worse
+float SurfaceBvh::cost() const {
+	float total = 0.0f;
+
+	for (size_t n = 0; n < nodeCount; n++) {
+		const Node& node = nodes[n];
+
+		for (int side = 0; side < 2; side++) {
+			Bounds bounds;
+			bounds.grow(glm::vec3(node.minX[side], node.minY[side], node.minZ[side]));
+			bounds.grow(glm::vec3(node.maxX[side], node.maxY[side], node.maxZ[side]));
+
+			total += bounds.area() * (node.count[side] > 0 ? node.count[side] : 1);
+		}
+	}
+
+	const Node& root = nodes[0];
+	Bounds rootBounds;
+
+	for (int side = 0; side < 2; side++) {
+		rootBounds.grow(glm::vec3(root.minX[side], root.minY[side], root.minZ[side]));
+		rootBounds.grow(glm::vec3(root.maxX[side], root.maxY[side], root.maxZ[side]));
+	}
+
+	return total / std::max(rootBounds.area(), 1e-12f);
+}
+
+// Moller-Trumbore
+bool SurfaceBvh::intersectTriangle(uint32_t triangle, const glm::vec3& origin, const glm::vec3& direction, float& distance, float& u, float& v) const {
+	const uint32_t* indices = triangles.data() + triangle * 3;
+
+	glm::vec3 p0 = positions[indices[0]];
+	glm::vec3 edge1 = positions[indices[1]] - p0;
+	glm::vec3 edge2 = positions[indices[2]] - p0;
+
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+
+	// Both faces count - the ray may start inside the shape
+	if (std::abs(determinant) < 1e-12f) {
+		return false;
+	}
+
+	float inverse = 1.0f / determinant;
+	glm::vec3 s = origin - p0;
+
+	u = glm::dot(s, p) * inverse;
+
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+
+	glm::vec3 q = glm::cross(s, edge1);
+	v = glm::dot(direction, q) * inverse;
+
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+
+	distance = glm::dot(edge2, q) * inverse;
+
+	return distance > 0.0f;
+}
+
+PickHit SurfaceBvh::intersect(glm::vec3 origin, glm::vec3 direction) const {
+	PickHit result;
+
+	if (nodeCount == 0) {
+		return result;
+	}
+
+	direction = glm::normalize(direction);
+
+	// Division by a zero component gives infinity, which the slab test handles
+	float inverseX = 1.0f / direction.x;
+	float inverseY = 1.0f / direction.y;
+	float inverseZ = 1.0f / direction.z;
+
+	float closest = 1e30f;
+	float hitU = 0.0f;
+	float hitV = 0.0f;
+
+	// Each pop pushes at most both children, one of which is popped next - so the stack never holds more than one node per
+	// level below the root, plus the one being visited
+	uint32_t fixedStack[64];
+	std::vector<uint32_t> largeStack;
+	uint32_t* stack = fixedStack;
+
+	if ((size_t)depth + 2 > sizeof(fixedStack) / sizeof(fixedStack[0])) {
+		largeStack.resize((size_t)depth + 2);
+		stack = largeStack.data();
+	}
+
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const Node& node = nodes[stack[--stackSize]];
+
+		// Both children's slabs at once - the same operations on two lanes
+		float entry[2];
+		float exit[2];
+
+		for (int side = 0; side < 2; side++) {
+			float x0 = (node.minX[side] - origin.x) * inverseX;
+			float x1 = (node.maxX[side] - origin.x) * inverseX;
+			float y0 = (node.minY[side] - origin.y) * inverseY;
+			float y1 = (node.maxY[side] - origin.y) * inverseY;
+			float z0 = (node.minZ[side] - origin.z) * inverseZ;
+			float z1 = (node.maxZ[side] - origin.z) * inverseZ;
+
+			entry[side] = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+			exit[side] = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), closest));
+		}
+
+		bool hit[2] = { entry[0] <= exit[0], entry[1] <= exit[1] };
+
+		// Nearer child popped first
+		int near = entry[1] < entry[0] ? 1 : 0;
+		int order[2] = { 1 - near, near };
+
+		for (int side : order) {
+			if (!hit[side]) {
+				continue;
+			}
+
+			if (node.count[side] == 0) {
+				stack[stackSize++] = node.child[side];
+				continue;
+			}
+
+			for (uint32_t i = node.child[side]; i < node.child[side] + node.count[side]; i++) {
+				float distance;
+				float u;
+				float v;
+
+				if (intersectTriangle(primitives[i], origin, direction, distance, u, v) && distance < closest) {
+					closest = distance;
+					hitU = u;
+					hitV = v;
+					result.hit = true;
+					result.triangle = primitives[i];
+				}
+			}
+		}
+	}
+
+	if (!result.hit) {
+		return result;
+	}
+
+	result.distance = closest;
+	result.position = origin + direction * closest;
+
+	// Longitude straight from the position (x and y share the factor r1 * r2 * cos(phi) >= 0); latitude interpolated
+	// across the triangle's rows, which never wrap
+	const uint32_t* indices = triangles.data() + result.triangle * 3;
+	size_t columns = 2 * detail;
+	float rowToPhi = glm::pi<float>() / (float)detail;
+
+	float phi0 = (float)(indices[0] / columns) * rowToPhi;
+	float phi1 = (float)(indices[1] / columns) * rowToPhi;
+	float phi2 = (float)(indices[2] / columns) * rowToPhi;
+
+	result.theta = std::atan2(result.position.y, result.position.x);
+	result.phi = -0.5f * glm::pi<float>() + (1.0f - hitU - hitV) * phi0 + hitU * phi1 + hitV * phi2;
+
+	return result;
+}
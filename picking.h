@@ -0,0 +1,121 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "struct.h"
+#include "fastMath.h"
+#include "memoryAccounting.h"
+
+/*
+Ray queries against the displaced supershape, on the CPU. The surface is the same grid and triangulation generateMesh()
+builds, displaced with the shader's formula (gielis.h), in the shape's unit-scale model space. Vertices take the shader's
+path through the chosen precision tier - angles recovered from the sphere with its atan2 and asin, then its cos and sin -
+so hits land on the surface drawn at that tier.
+
+The BVH is binary, built top-down with binned SAH; subtrees over large ranges are built on their own threads. Each node
+stores the bounds of both of its children side by side, so one slab test covers the pair. Small ranges become leaves held
+directly in their parent.
+
+When only the shape parameters change (the animated m), refit() moves the vertices and recomputes bounds bottom-up,
+keeping the tree. That costs a fraction of a rebuild, and the tree only gets looser; it is rebuilt once the root's SAH cost
+has drifted too far from its cost at build time.
+*/
+
+struct PickHit {
+	bool hit = false;
+
+	float distance = 0.0f; // Along the (normalised) ray direction
+	glm::vec3 position{ 0.0f };
+
+	// Spherical coordinates of the hit on the undisplaced sphere
+	float theta = 0.0f;
+	float phi = 0.0f;
+
+	uint32_t triangle = 0;
+};
+
+class SurfaceBvh {
+public:
+	// precision, radius and sectors should match the shader's SHADER_PRECISION and the drawn mesh, so hits land on the
+	// surface that is drawn
+	void build(const SupershapeParams& shape, size_t detail, Precision precision = Precision::Exact, float radius = 2.0f, uint32_t sectors = 1);
+
+	// Same detail, new shape: a refit, or a rebuild if the tree has degraded too far
+	void update(const SupershapeParams& shape);
+
+	PickHit intersect(glm::vec3 origin, glm::vec3 direction) const;
+
+	size_t getDetail() const { return detail; }
+	const SupershapeParams& getShape() const { return shape; }
+	size_t getNodeCount() const { return nodeCount; }
+
+private:
+	// The pair of children of a node, in one cache line. Leaf children hold [first, first + count) of primitives; inner ones
+	// an index in nodes
+	struct alignas(64) Node {
+		float minX[2], minY[2], minZ[2];
+		float maxX[2], maxY[2], maxZ[2];
+
+		uint32_t child[2];
+		uint32_t count[2]; // 0 for an inner child
+	};
+
+	struct Bounds {
+		glm::vec3 min{ 1e30f };
+		glm::vec3 max{ -1e30f };
+
+		void grow(const glm::vec3& point) {
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+
+		void grow(const Bounds& other) {
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+
+		float area() const;
+	};
+
+	size_t detail = 0;
+	SupershapeParams shape{};
+	Precision precision = Precision::Exact;
+	float radius = 2.0f;
+	uint32_t sectors = 1;
+
+	TrackedVector<glm::vec3, HostMemory::Picking> positions;
+	TrackedVector<uint32_t, HostMemory::Picking> triangles; // 3 vertex indices each, as generateMesh() orders them
+	TrackedVector<uint32_t, HostMemory::Picking> primitives; // Triangle indices, in leaf order
+
+	TrackedVector<Node, HostMemory::Picking> nodes;
+	std::atomic<size_t> nodeCount{ 0 };
+	std::atomic<int> depth{ 0 }; // Of the deepest inner node, the root being 0 - bounds the traversal stack
+	float builtCost = 0.0f;
+
+	// Only used while building - partitioned in place, so every pass over a range reads memory in order
+	struct BuildPrimitive {
+		Bounds bounds;
+		glm::vec3 centroid;
+		uint32_t triangle;
+	};
+
+	TrackedVector<BuildPrimitive, HostMemory::Picking> buildPrimitives;
+	Node* buildNodes = nullptr;
+	int parallelDepth = 0;
+
+	void computePositions();
+	template<Precision P>
+	void computePositionsIn();
+	void buildRange(uint32_t nodeIndex, uint32_t first, uint32_t count, int depth);
+	uint32_t split(uint32_t first, uint32_t count);
+	Bounds rangeBounds(uint32_t first, uint32_t count) const;
+	static void setChild(Node& node, int side, const Bounds& bounds);
+	void refit();
+	float cost() const;
+
+	bool intersectTriangle(uint32_t triangle, const glm::vec3& origin, const glm::vec3& direction, float& distance, float& u, float& v) const;
+};
@@ -0,0 +1,193 @@
+#include "replay.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+const char REPLAY_MAGIC[4] = { 'S', 'S', 'R', 'P' };
+const uint32_t REPLAY_VERSION = 2; // 1 numbered frames with gaps where one was dropped
+
+void InputRecorder::start(std::chrono::steady_clock::time_point origin) {
+	this->origin = origin;
+	records.clear();
+	recording = true;
+}
+
+void InputRecorder::add(ReplayRecordType type, uint32_t frame, std::chrono::steady_clock::time_point time, int code, int action,
+	float dx, float dy) {
+	if (!recording) {
+		return;
+	}
+
+	ReplayRecord record{};
+	record.frame = frame;
+	record.type = type;
+	record.action = (int8_t)action;
+	record.code = (uint16_t)code;
+	record.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(time - origin).count();
+	record.dx = dx;
+	record.dy = dy;
+
+	records.push_back(record);
+}
+
+bool InputRecorder::save(const std::string& path) const {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	file.write(REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+	file.write(reinterpret_cast<const char*>(&REPLAY_VERSION), sizeof(REPLAY_VERSION));
+	file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(ReplayRecord));
+
+	return (bool)file;
+}
+
+bool InputReplay::load(const std::string& path, ReplayTiming timing, float timestep) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	size_t fileSize = (size_t)file.tellg();
+	file.seekg(0);
+
+	char magic[4];
+	uint32_t version = 0;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+
+	if (!file || std::memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0 || version != REPLAY_VERSION) {
+		return false;
+	}
+
+	std::vector<ReplayRecord> records((fileSize - 8) / sizeof(ReplayRecord));
+	file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(ReplayRecord));
+
+	if (!file) {
+		return false;
+	}
+
+	this->timing = timing;
+	timestepNs = std::llround((double)timestep * 1e9);
+
+	inputs.clear();
+	frameTimes.clear();
+	durationNs = 0;
+
+	for (const ReplayRecord& record : records) {
+		durationNs = std::max(durationNs, record.timeNs);
+
+		if (record.type != ReplayRecordType::Frame) {
+			inputs.push_back(record);
+			continue;
+		}
+
+		// Frames are numbered without gaps - anything further ahead would size the table from untrusted data
+		if (record.frame > frameTimes.size()) {
+			throw std::runtime_error("Replay file is corrupt!");
+		}
+
+		if (record.frame == frameTimes.size()) {
+			frameTimes.push_back(record.timeNs);
+		}
+		else {
+			frameTimes[record.frame] = record.timeNs;
+		}
+	}
+
+	nextInput = 0;
+	replaying = true;
+
+	return true;
+}
+
+void InputReplay::start(std::chrono::steady_clock::time_point origin) {
+	this->origin = origin;
+	lastFrameTimeNs = 0;
+	nextInput = 0;
+}
+
+bool InputReplay::finished(uint32_t frame) const {
+	// Input after the last frame (the key that closed the window) changed nothing on screen
+	if (timing == ReplayTiming::Recorded) {
+		return frame >= frameTimes.size();
+	}
+
+	return nextInput == inputs.size() && (int64_t)frame * timestepNs >= durationNs;
+}
+
+std::vector<ReplayRecord> InputReplay::takeInputs(uint32_t frame) {
+	std::vector<ReplayRecord> due;
+
+	// Recorded: everything that arrived before this frame. FixedStep: everything up to the clock this frame will reach
+	int64_t fixedClockNs = ((int64_t)frame + 1) * timestepNs;
+
+	while (nextInput < inputs.size()) {
+		const ReplayRecord& input = inputs[nextInput];
+		bool isDue = timing == ReplayTiming::Recorded ? input.frame <= frame : input.timeNs <= fixedClockNs;
+
+		if (!isDue) {
+			break;
+		}
+
+		due.push_back(input);
+		nextInput++;
+	}
+
+	return due;
+}
+
+std::chrono::steady_clock::time_point InputReplay::frameTime(uint32_t frame) {
+	if (timing == ReplayTiming::FixedStep) {
+		lastFrameTimeNs = ((int64_t)frame + 1) * timestepNs;
+	}
+	else if (frame < frameTimes.size()) {
+		lastFrameTimeNs = frameTimes[frame];
+	}
+
+	return toTime(lastFrameTimeNs);
+}
+
+void InputReplay::addTiming(uint32_t frame, float frameMs, float fenceWaitMs) {
+	timings.push_back({ frame, frameMs, fenceWaitMs });
+}
+
+void InputReplay::writeTimings(const std::string& path) const {
+	if (timings.empty()) {
+		return;
+	}
+
+	std::ofstream file(path, std::ios::trunc);
+
+	if (!file.is_open()) {
+		LogLine(LogLevel::Warning) << "Failed to write " << path << "!";
+	}
+	else {
+		file << "frame,frame_ms,fence_wait_ms\n";
+
+		for (const FrameTiming& timing : timings) {
+			file << timing.frame << "," << timing.frameMs << "," << timing.fenceWaitMs << "\n";
+		}
+	}
+
+	std::vector<float> sorted;
+	double totalMs = 0.0;
+
+	for (const FrameTiming& timing : timings) {
+		sorted.push_back(timing.frameMs);
+		totalMs += timing.frameMs;
+	}
+
+	std::sort(sorted.begin(), sorted.end());
+
+	LogLine(LogLevel::Info) << "Replay: " << timings.size() << " frames in " << totalMs / 1000.0 << " s, " << totalMs / timings.size()
+		<< " ms average, p50 " << sorted[sorted.size() / 2] << " ms, p99 " << sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)]
+		<< " ms, worst " << sorted.back() << " ms (per frame: " << path << ")";
+}
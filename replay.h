@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+Input recording and deterministic replay, so two builds can be timed on the same flythrough.
+
+A recording is every input the app acted on (keys, cursor moves, mouse buttons), tagged with the frame it arrived before and
+its time, plus the clock each frame's camera and animation were advanced to. Times are nanoseconds since the recording
+started. Replaying feeds the same inputs through the same handlers and drives the same clock, so frame N sees exactly the
+camera and animation state it had when recorded - however fast the frames are actually drawn:
+
+ - Recorded: frame by frame as recorded, each frame at its recorded time
+ - FixedStep: the clock advances by a fixed step every frame, and inputs are applied once the clock has passed them -
+   the same path, sampled evenly
+
+Either way nothing waits on the wall clock, so a replay runs as fast as the GPU and present mode allow. Only work that
+finishes asynchronously (a new detail level's mesh) may land a frame or two apart between runs.
+
+File layout: an 8-byte header ("SSRP", version), then fixed-size little-endian ReplayRecords in the order they happened.
+Frames are numbered from 0 without gaps; a file that skips ahead is rejected as corrupt.
+*/
+
+enum class ReplayTiming {
+	Recorded,
+	FixedStep
+};
+
+enum class ReplayRecordType : uint8_t {
+	Frame = 0, // timeNs is the clock the frame was advanced to
+	Key = 1, // code = GLFW key, action = GLFW action
+	Cursor = 2, // dx, dy = cursor movement
+	MouseButton = 3 // code = GLFW button, action = GLFW action
+};
+
+struct ReplayRecord {
+	uint32_t frame;
+	ReplayRecordType type;
+	int8_t action;
+	uint16_t code;
+	int64_t timeNs;
+	float dx;
+	float dy;
+};
+
+static_assert(sizeof(ReplayRecord) == 24, "The replay file layout must not depend on the compiler!");
+
+// Buffered in memory and written out at the end, so recording costs nothing per frame but a push_back
+class InputRecorder {
+public:
+	void start(std::chrono::steady_clock::time_point origin);
+	void add(ReplayRecordType type, uint32_t frame, std::chrono::steady_clock::time_point time, int code = 0, int action = 0,
+		float dx = 0.0f, float dy = 0.0f);
+
+	bool save(const std::string& path) const;
+
+	bool isRecording() const { return recording; }
+	size_t getRecordCount() const { return records.size(); }
+
+private:
+	bool recording = false;
+	std::chrono::steady_clock::time_point origin;
+	std::vector<ReplayRecord> records;
+};
+
+class InputReplay {
+public:
+	bool load(const std::string& path, ReplayTiming timing, float timestep);
+	void start(std::chrono::steady_clock::time_point origin);
+
+	bool isReplaying() const { return replaying; }
+
+	// True once every recorded frame (Recorded) or the recorded duration (FixedStep) has been played
+	bool finished(uint32_t frame) const;
+
+	// The inputs to apply before drawing frame, in order; consumed as they are returned
+	std::vector<ReplayRecord> takeInputs(uint32_t frame);
+
+	// The clock frame is advanced to. A frame past the end of the recording repeats the previous one
+	std::chrono::steady_clock::time_point frameTime(uint32_t frame);
+
+	std::chrono::steady_clock::time_point toTime(int64_t timeNs) const {
+		return origin + std::chrono::nanoseconds(timeNs);
+	}
+
+	// Per-frame CPU time and fence wait of the replay, written out as CSV alongside a summary at the end
+	void addTiming(uint32_t frame, float frameMs, float fenceWaitMs);
+	void writeTimings(const std::string& path) const;
+
+private:
+	bool replaying = false;
+	ReplayTiming timing = ReplayTiming::Recorded;
+	int64_t timestepNs = 0;
+
+	std::chrono::steady_clock::time_point origin;
+
+	std::vector<ReplayRecord> inputs;
+	std::vector<int64_t> frameTimes; // Recorded clock per frame
+	size_t nextInput = 0;
+
+	int64_t lastFrameTimeNs = 0;
+	int64_t durationNs = 0;
+
+	struct FrameTiming {
+		uint32_t frame;
+		float frameMs;
+		float fenceWaitMs;
+	};
+
+	std::vector<FrameTiming> timings;
+};
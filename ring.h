@@ -0,0 +1,236 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/*
+Fixed-size single-producer single-consumer queue. One thread may push() while another pop()s, with no locks - each side
+only ever writes its own index. push() fails rather than blocks when the ring is full.
+*/
+
+template<typename T, size_t Capacity>
+class SpscRing {
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two!");
+
+public:
+	bool push(const T& item) {
+		size_t head = this->head.load(std::memory_order_relaxed);
+
+		if (head - tail.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+
+		items[head & (Capacity - 1)] = item;
+		this->head.store(head + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	bool pop(T& item) {
+		size_t tail = this->tail.load(std::memory_order_relaxed);
+
+		if (tail == head.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		item = items[tail & (Capacity - 1)];
+		this->tail.store(tail + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	bool empty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+private:
+	T items[Capacity];
+
+	// On separate cache lines, so the producer and consumer don't fight over one
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+};
+
+/*
+Fixed-size multi-producer single-consumer queue (Vyukov's bounded queue). Each cell carries a sequence number saying whose
+turn it is: producers claim a cell with one compare-and-swap on the shared head, fill it in place and publish it by bumping
+its sequence; the consumer only reads cells whose sequence says they are published. Items are written and read in place,
+through callbacks, so large ones are never copied twice. push() fails rather than blocks when the ring is full.
+*/
+
+template<typename T, size_t Capacity>
+class MpscRing {
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two!");
+
+public:
+	MpscRing() {
+		for (size_t i = 0; i < Capacity; i++) {
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	// Calls fill(T&) on a claimed cell
+	template<typename Fill>
+	bool push(Fill&& fill) {
+		size_t head = this->head.load(std::memory_order_relaxed);
+		Cell* cell;
+
+		while (true) {
+			cell = &cells[head & (Capacity - 1)];
+			std::ptrdiff_t lag = (std::ptrdiff_t)(cell->sequence.load(std::memory_order_acquire) - head);
+
+			if (lag == 0) {
+				if (this->head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if (lag < 0) {
+				return false; // Still holds an item from the previous lap
+			}
+			else {
+				head = this->head.load(std::memory_order_relaxed);
+			}
+		}
+
+		fill(cell->item);
+		cell->sequence.store(head + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	// Calls consume(T&) on the oldest published item. Consumer thread only
+	template<typename Consume>
+	bool pop(Consume&& consume) {
+		Cell& cell = cells[tail & (Capacity - 1)];
+
+		if (cell.sequence.load(std::memory_order_acquire) != tail + 1) {
+			return false;
+		}
+
+		consume(cell.item);
+		cell.sequence.store(tail + Capacity, std::memory_order_release);
+		tail++;
+		popped.store(tail, std::memory_order_release);
+
+		return true;
+	}
+
+	// Items claimed so far, and items consumed so far - comparing the two tells when everything pushed before has been read
+	size_t pushedCount() const {
+		return head.load(std::memory_order_acquire);
+	}
+
+	size_t poppedCount() const {
+		return popped.load(std::memory_order_acquire);
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T item;
+	};
+
+	Cell cells[Capacity];
+
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) size_t tail = 0;
+	std::atomic<size_t> popped{ 0 };
+};
+
+/*
+Triple buffer: one writer publishes whole snapshots of T, one reader takes the most recent - both wait-free, and neither
+ever sees the other's slot. The writer fills its private back slot, then swaps it with the shared middle slot in a single
+exchange that also marks it new; the reader swaps its front slot with the middle only when it is marked new. Snapshots the
+reader never took are simply overwritten, so a fast writer costs a slow reader nothing.
+*/
+
+template<typename T>
+class TripleBuffer {
+public:
+	// The writer's slot, to fill in before publish(). Holds an older snapshot, not necessarily the last one published
+	T& back() {
+		return slots[backIndex].value;
+	}
+
+	// Makes the back slot the latest snapshot. Returns false if the one it replaces was never taken by the reader
+	bool publish() {
+		uint8_t previous = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel);
+		backIndex = previous & INDEX;
+
+		return (previous & FRESH) == 0;
+	}
+
+	// Whether a snapshot newer than front() is waiting. Either thread
+	bool pending() const {
+		return (middle.load(std::memory_order_relaxed) & FRESH) != 0;
+	}
+
+	// Takes the latest snapshot into front(), if there is a newer one. Reader thread only
+	bool update() {
+		if (!pending()) {
+			return false;
+		}
+
+		uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+		frontIndex = previous & INDEX;
+
+		return true;
+	}
+
+	// Stays valid and unchanged until the next update()
+	const T& front() const {
+		return slots[frontIndex].value;
+	}
+
+private:
+	static constexpr uint8_t INDEX = 3;
+	static constexpr uint8_t FRESH = 4;
+
+	// A cache line each, so the writer filling one never slows the reader reading another
+	struct alignas(64) Slot {
+		T value{};
+	};
+
+	Slot slots[3];
+
+	alignas(64) std::atomic<uint8_t> middle{ 1 };
+	alignas(64) uint8_t backIndex = 0; // Writer only
+	alignas(64) uint8_t frontIndex = 2; // Reader only
+};
+
+/*
+Lets the consumer of the queues above sleep until a producer has something for it. notify() costs one atomic exchange
+while a wakeup is already pending, and only locks to signal the first one; the consumer clears the wakeup as it returns,
+so anything pushed while it was busy makes its next wait return at once rather than being missed.
+*/
+
+class Wakeup {
+public:
+	// Any thread
+	void notify() {
+		if (signalled.exchange(true, std::memory_order_acq_rel)) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		condition.notify_one();
+	}
+
+	// Consumer thread only. Returns whether it was woken rather than timed out
+	template<typename Rep, typename Period>
+	bool waitFor(std::chrono::duration<Rep, Period> timeout) {
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait_for(lock, timeout, [this]() { return signalled.load(std::memory_order_acquire); });
+
+		return signalled.exchange(false, std::memory_order_acq_rel);
+	}
+
+private:
+	std::atomic<bool> signalled{ false };
+	std::mutex mutex;
+	std::condition_variable condition;
+};
@@ -1,9 +1,20 @@
 #version 450
 
+// Depth is tested before shading, so hidden fragments never run this shader
+layout(early_fragment_tests) in;
+
+// Set by the overdraw pipeline - a flat colour, additively blended, so brightness counts the layers shaded per pixel
+layout(constant_id = 0) const bool OVERDRAW = false;
+
 layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    if (OVERDRAW) {
+        outColor = vec4(0.1, 0.05, 0.02, 1.0);
+    }
+    else {
+        outColor = vec4(fragColor, 1.0);
+    }
 }
@@ -1,66 +1,203 @@
 #version 450
 #extension GL_KHR_vulkan_glsl : enable
 
+struct SupershapeParams {
+    float m;
+    float n1;
+    float n2;
+    float n3;
+    float a;
+    float b;
+};
+
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
     float time;
+    SupershapeParams shape;
 } ubo;
 
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+    uint sectors;
+    uint sectorColumns;
+} draw;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColour;
 
 layout(location = 0) out vec3 fragColour;
 
-float supershape(float alpha, float m) {
-    float a = 1;
-    float b = 1;
-    
-    float n1 = 0.2;
-    float n2 = 1.7;
-    float n3 = 1.7;
+// Precision tier, as in fastMath.h: 0 = exact built-ins, 1 = Fast, 2 = Fastest. A specialisation constant, so the
+// unused tiers are compiled out of each pipeline
+layout(constant_id = 0) const int PRECISION = 0;
+
+const float PI_HIGH = 3.140625;
+const float PI_LOW = 9.67653589793e-4;
+const float HALF_PI = 1.57079632679490;
+
+float sinReduced(float r) {
+    float r2 = r * r;
+
+    if (PRECISION == 1) {
+        return r * (0.99999999469 + r2 * (-0.16666656684 + r2 * (0.0083330251390 + r2 * (-1.9807418728e-4 + r2 * 2.6019030680e-6))));
+    }
+
+    return r * (0.99989182126 + r2 * (-0.16596011654 + r2 * 0.0076029033434));
+}
+
+float fastSin(float x) {
+    if (PRECISION == 0) {
+        return sin(x);
+    }
+
+    float k = round(x / 3.14159265358979);
+    float s = sinReduced((x - k * PI_HIGH) - k * PI_LOW);
+
+    return (int(k) & 1) != 0 ? -s : s;
+}
+
+float fastCos(float x) {
+    if (PRECISION == 0) {
+        return cos(x);
+    }
+
+    float k = round(x / 3.14159265358979 + 0.5);
+    float offset = k - 0.5;
+    float s = sinReduced((x - offset * PI_HIGH) - offset * PI_LOW);
+
+    return (int(k) & 1) != 0 ? -s : s;
+}
+
+float fastLog2(float x) {
+    float exponent = float(((floatBitsToInt(x) >> 23) & 0xFF) - 127);
+    float t = intBitsToFloat((floatBitsToInt(x) & 0x007FFFFF) | 0x3F800000) - 1.0;
+
+    if (PRECISION == 1) {
+        return exponent + t * (1.4426738997 + t * (-0.72063170410 + t * (0.47351812105 + t * (-0.32504162789 + t * (0.19210598503
+            + t * (-0.077403394507 + t * 0.014778720766))))));
+    }
+
+    return exponent + t * (1.4389484406 + t * (-0.67715076447 + t * (0.31821322082 + t * -0.080010896934)));
+}
+
+float fastExp2(float x) {
+    // Split first, then clamped - saturating like fastMath.h rather than extrapolating the polynomial
+    float whole = float(int(x + 128.0)) - 128.0;
+    float f = x - whole;
+    whole = clamp(whole, -126.0, 127.0);
 
-    float t1 = pow(abs((1 / a) * cos(m * alpha / 4)), n2);
-    float t2 = pow(abs((1 / b) * sin(m * alpha / 4)), n3);
+    float p;
 
-    return pow(t1 + t2, -1 / n1);
+    if (PRECISION == 1) {
+        p = 0.99999992506 + f * (0.69315307320 + f * (0.24015361705 + f * (0.055826318050 + f * (0.0089893400947 + f * 0.0018775766734))));
+    }
+    else {
+        p = 0.99992521856 + f * (0.69583354051 + f * (0.22606715539 + f * 0.078024522664));
+    }
+
+    return p * intBitsToFloat((int(whole) + 127) << 23);
+}
+
+// base >= 0
+float fastPow(float base, float exponent) {
+    if (PRECISION == 0) {
+        return pow(base, exponent);
+    }
+
+    float result = fastExp2(exponent * fastLog2(base));
+
+    return base > 0.0 ? result : (exponent > 0.0 ? 0.0 : uintBitsToFloat(0x7F800000u));
+}
+
+float fastAtan2(float y, float x) {
+    if (PRECISION == 0) {
+        return atan(y, x);
+    }
+
+    float ax = abs(x);
+    float ay = abs(y);
+    float high = max(ax, ay);
+    float a = high > 0.0 ? min(ax, ay) / high : 0.0;
+    float s = a * a;
+    float r;
+
+    if (PRECISION == 1) {
+        r = a * (0.99999997596 + s * (-0.33332251836 + s * (0.19957728206 + s * (-0.13833401501 + s * (0.090705021720
+            + s * (-0.043091381655 + s * 0.0098637986918))))));
+    }
+    else {
+        r = a * (0.99807414605 + s * (-0.29574362421 + s * 0.083067641559));
+    }
+
+    r = ay > ax ? HALF_PI - r : r;
+    r = x < 0.0 ? 3.14159265358979 - r : r;
+
+    return y < 0.0 ? -r : r;
+}
+
+float fastAsin(float x) {
+    if (PRECISION == 0) {
+        return asin(x);
+    }
+
+    float a = min(abs(x), 1.0);
+    float p;
+
+    if (PRECISION == 1) {
+        p = 1.5707963268 + a * (-0.21460122215 + a * (0.089022350941 + a * (-0.050462444642 + a * (0.031795417170
+            + a * (-0.018531518113 + a * (0.0078060568613 + a * -0.0016117456600))))));
+    }
+    else {
+        p = 1.5707963100 + a * (-0.21371549012 + a * (0.079577773345 + a * -0.022976421142));
+    }
+
+    float r = HALF_PI - sqrt(1.0 - a) * p;
+
+    return x < 0.0 ? -r : r;
+}
+
+float supershape(float alpha, SupershapeParams shape) {
+    float t1 = fastPow(abs((1 / shape.a) * fastCos(shape.m * alpha / 4)), shape.n2);
+    float t2 = fastPow(abs((1 / shape.b) * fastSin(shape.m * alpha / 4)), shape.n3);
+
+    return fastPow(t1 + t2, -1 / shape.n1);
 }
 
 // Returns (theta, phi)
 vec2 angles(vec3 pos, float rho) {
-    float theta = atan(pos.y, pos.x);
+    float theta = fastAtan2(pos.y, pos.x);
     // float phi = acos(pos.z / rho);
-    float phi = asin(pos.z / rho);
+    float phi = fastAsin(pos.z / rho);
 
     return vec2(theta, phi);
 }
 
-float map(float value, float a1, float b1, float a2, float b2) {
-    float range1 = b1 - a1;
-    float range2 = b2 - a2;
-
-    return a2 + (value - a1) * range2 / range1;
-}
-
 void main() {
     float PI = 3.141592653589793;
 
     float rho = 2.0;
 
-    float m = map(sin(ubo.time), -1, 1, 0, 7);
-
     // Cartesian --> spherical
     vec2 angles = angles(inPosition, rho);
 
+    // One sector of the grid per instance (see mesh.h). theta comes from the vertex's integer column in the whole grid, not
+    // from rotating its position, so a seam vertex gets exactly the same angle from both sectors it closes - watertight
+    if (draw.sectors > 1) {
+        uint totalColumns = draw.sectors * draw.sectorColumns;
+        uint column = (uint(gl_VertexIndex) % (draw.sectorColumns + 1) + uint(gl_InstanceIndex) * draw.sectorColumns) % totalColumns;
+
+        angles.x = -PI + 2.0 * PI * float(column) / float(totalColumns);
+    }
+
     // Spherical --> superspherical
-    float r1 = supershape(angles.x, m);
-    float r2 = supershape(angles.y, m);
+    float r1 = supershape(angles.x, ubo.shape);
+    float r2 = supershape(angles.y, ubo.shape);
 
-    float x = rho * r1 * cos(angles.x) * r2 * cos(angles.y);
-    float y = rho * r1 * sin(angles.x) * r2 * cos(angles.y);
-    float z = rho * r2 * sin(angles.y);
+    float x = rho * r1 * fastCos(angles.x) * r2 * fastCos(angles.y);
+    float y = rho * r1 * fastSin(angles.x) * r2 * fastCos(angles.y);
+    float z = rho * r2 * fastSin(angles.y);
 
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(x, y, z, rho);
+    gl_Position = ubo.proj * ubo.view * draw.model * vec4(x, y, z, rho);
     fragColour = vec3(pow(sin(x), 2.0f), pow(sin(y), 2.0f), pow(sin(z), 2.0f));
 }
@@ -0,0 +1,124 @@
+#include "shaders.h"
+#include "log.h"
+
+#include <stdexcept>
+#include <string>
+#include <cstdlib>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t vertShaderWords[] = {
+#include "shaders/vert.spv.inc"
+};
+
+static const uint32_t fragShaderWords[] = {
+#include "shaders/frag.spv.inc"
+};
+
+// Maps a SPIR-V file read-only; the driver copies the code on vkCreateShaderModule, so the mapping is short-lived
+static ShaderCode mapShaderFile(const std::string& filename) {
+	ShaderCode shaderCode{};
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open shader file " + filename + "!");
+	}
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to read the size of shader file " + filename + "!");
+	}
+
+	HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+
+	if (fileMapping == nullptr) {
+		throw std::runtime_error("Failed to map shader file " + filename + "!");
+	}
+
+	shaderCode.mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(fileMapping); // The view keeps the mapping alive
+
+	shaderCode.mappingSize = (size_t)fileSize.QuadPart;
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+
+	if (file < 0) {
+		throw std::runtime_error("Failed to open shader file " + filename + "!");
+	}
+
+	struct stat fileStat;
+
+	if (fstat(file, &fileStat) != 0) {
+		close(file);
+		throw std::runtime_error("Failed to read the size of shader file " + filename + "!");
+	}
+
+	shaderCode.mappingSize = (size_t)fileStat.st_size;
+	shaderCode.mapping = mmap(nullptr, shaderCode.mappingSize, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file); // The mapping keeps the file alive
+
+	if (shaderCode.mapping == MAP_FAILED) {
+		shaderCode.mapping = nullptr;
+	}
+#endif
+
+	if (shaderCode.mapping == nullptr || shaderCode.mappingSize == 0 || shaderCode.mappingSize % sizeof(uint32_t) != 0) {
+		releaseShaderCode(shaderCode);
+		throw std::runtime_error("Shader file " + filename + " is not valid SPIR-V!");
+	}
+
+	// Page-aligned, so always suitably aligned for uint32_t
+	shaderCode.code = static_cast<const uint32_t*>(shaderCode.mapping);
+	shaderCode.size = shaderCode.mappingSize;
+
+	return shaderCode;
+}
+
+static ShaderCode loadShaderCode(const char* filename, const uint32_t* embeddedWords, size_t embeddedSize) {
+	const char* shaderDir = std::getenv("SUPERSHAPE_SHADER_DIR");
+
+	if (shaderDir != nullptr && shaderDir[0] != '\0') {
+		LogLine(LogLevel::Info) << "Loading " << filename << " from " << shaderDir;
+		return mapShaderFile(std::string(shaderDir) + "/" + filename);
+	}
+
+	ShaderCode shaderCode{};
+	shaderCode.code = embeddedWords;
+	shaderCode.size = embeddedSize;
+
+	return shaderCode;
+}
+
+extern ShaderCode loadVertexShaderCode() {
+	return loadShaderCode("vert.spv", vertShaderWords, sizeof(vertShaderWords));
+}
+
+extern ShaderCode loadFragmentShaderCode() {
+	return loadShaderCode("frag.spv", fragShaderWords, sizeof(fragShaderWords));
+}
+
+extern void releaseShaderCode(ShaderCode& shaderCode) {
+	if (shaderCode.mapping != nullptr) {
+#ifdef _WIN32
+		UnmapViewOfFile(shaderCode.mapping);
+#else
+		munmap(shaderCode.mapping, shaderCode.mappingSize);
+#endif
+	}
+
+	shaderCode = ShaderCode{};
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+SPIR-V is compiled ahead of time by compileShaders (glslc -mfmt=num) and embedded into the binary as uint32_t word arrays,
+so the shaders can be handed straight to vkCreateShaderModule with no file I/O or copies.
+
+For shader development, setting SUPERSHAPE_SHADER_DIR makes the loader memory-map <dir>/vert.spv and <dir>/frag.spv instead.
+*/
+
+struct ShaderCode {
+	const uint32_t* code = nullptr;
+	size_t size = 0; // In bytes, as VkShaderModuleCreateInfo expects
+
+	// Only set when the code is memory-mapped from disk
+	void* mapping = nullptr;
+	size_t mappingSize = 0;
+};
+
+extern ShaderCode loadVertexShaderCode();
+extern ShaderCode loadFragmentShaderCode();
+
+extern void releaseShaderCode(ShaderCode& shaderCode);
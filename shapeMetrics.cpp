@@ -0,0 +1,219 @@
+#include "shapeMetrics.h"
+#include "gielis.h"
+#include "log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Independent partial sums, wide enough for the compiler to keep each in its own SIMD lane; summing strictly in order would
+// serialise the loop on the add latency (and without -ffast-math the compiler may not reorder it for us).
+// The sqrt only vectorises with -fno-math-errno
+const size_t LANES = 8;
+
+struct PartialSums {
+	double area = 0.0;
+	double volume = 0.0;
+};
+
+/*
+Point (i, j) of the grid is (cx[j] * rc[i], sy[j] * rc[i], rz[i]):
+ - cx, sy: r1(theta) cos(theta) and r1(theta) sin(theta), one per column, with column 0 repeated at the end for the wrap
+ - rc, rz: r2(phi) cos(phi) and r2(phi) sin(phi), one per row
+*/
+struct Grid {
+	std::vector<double> cx;
+	std::vector<double> sy;
+	std::vector<double> rc;
+	std::vector<double> rz;
+};
+
+// Quad (i, j) as generateMesh() splits it into two triangles, added to one lane's sums
+static inline void addQuad(const double* cx, const double* sy, size_t j, double rc0, double rc1, double z0, double z1, double& area, double& volume) {
+	// Bottom left, bottom right, top left, top right
+	double ax = cx[j] * rc0, ay = sy[j] * rc0;
+	double bx = cx[j + 1] * rc0, by = sy[j + 1] * rc0;
+	double cX = cx[j] * rc1, cY = sy[j] * rc1;
+	double dx = cx[j + 1] * rc1, dy = sy[j + 1] * rc1;
+	double dz = z1 - z0;
+
+	// Triangle #1 (a, b, c) - a and b share a row, so (b - a) has no z
+	double ux = bx - ax, uy = by - ay;
+	double vx = cX - ax, vy = cY - ay;
+	double nx = uy * dz;
+	double ny = -ux * dz;
+	double nz = ux * vy - uy * vx;
+
+	// Triangle #2 (b, d, c) - c and d share a row, so (c - d) has no z
+	double sx = dx - bx, sy2 = dy - by;
+	double tx = cX - dx, ty = cY - dy;
+	double mx = -ty * dz;
+	double my = tx * dz;
+	double mz = sx * ty - sy2 * tx;
+
+	area += 0.5 * (std::sqrt(nx * nx + ny * ny + nz * nz) + std::sqrt(mx * mx + my * my + mz * mz));
+
+	// Signed tetrahedra against the origin; the sum over a closed surface is its volume
+	volume += (ax * nx + ay * ny + z0 * nz + bx * mx + by * my + z0 * mz) / 6.0;
+}
+
+// Quads between rows [firstRow, lastRow) and the row above each
+static PartialSums sumRows(const Grid& grid, size_t firstRow, size_t lastRow) {
+	size_t columns = grid.cx.size() - 1;
+	size_t fullColumns = columns - columns % LANES;
+
+	const double* cx = grid.cx.data();
+	const double* sy = grid.sy.data();
+
+	double area[LANES] = {};
+	double volume[LANES] = {};
+
+	for (size_t i = firstRow; i < lastRow; i++) {
+		double rc0 = grid.rc[i];
+		double rc1 = grid.rc[i + 1];
+		double z0 = grid.rz[i];
+		double z1 = grid.rz[i + 1];
+
+		// A fixed trip count over the lanes is what lets this vectorise
+		for (size_t j = 0; j < fullColumns; j += LANES) {
+			for (size_t k = 0; k < LANES; k++) {
+				addQuad(cx, sy, j + k, rc0, rc1, z0, z1, area[k], volume[k]);
+			}
+		}
+
+		for (size_t j = fullColumns; j < columns; j++) {
+			addQuad(cx, sy, j, rc0, rc1, z0, z1, area[0], volume[0]);
+		}
+	}
+
+	PartialSums sums;
+
+	for (size_t k = 0; k < LANES; k++) {
+		sums.area += area[k];
+		sums.volume += volume[k];
+	}
+
+	return sums;
+}
+
+ShapeMetrics measureSupershape(const SupershapeParams& shape, size_t detail, uint32_t threadCount) {
+	// A grid needs at least one row between the poles
+	if (detail == 0) {
+		throw std::runtime_error("Failed to measure supershape - detail must be at least 1!");
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const double pi = 3.141592653589793;
+
+	size_t columns = 2 * detail;
+	size_t rows = detail + 1;
+
+	Grid grid;
+	grid.cx.resize(columns + 1);
+	grid.sy.resize(columns + 1);
+	grid.rc.resize(rows);
+	grid.rz.resize(rows);
+
+	// The same angles generateMesh() places its vertices at
+	for (size_t j = 0; j < columns; j++) {
+		double theta = -pi + 2.0 * pi * (double)j / (double)columns;
+		double r1 = supershapeRadius(theta, shape);
+
+		grid.cx[j] = r1 * std::cos(theta);
+		grid.sy[j] = r1 * std::sin(theta);
+	}
+
+	grid.cx[columns] = grid.cx[0];
+	grid.sy[columns] = grid.sy[0];
+
+	for (size_t i = 0; i < rows; i++) {
+		double phi = -0.5 * pi + pi * (double)i / (double)detail;
+		double r2 = supershapeRadius(phi, shape);
+
+		grid.rc[i] = r2 * std::cos(phi);
+		grid.rz[i] = r2 * std::sin(phi);
+	}
+
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	threadCount = (uint32_t)std::min<size_t>(threadCount, detail);
+
+	std::vector<PartialSums> partials(threadCount);
+	std::vector<std::thread> threads;
+
+	// The calling thread takes the first share
+	for (uint32_t t = 1; t < threadCount; t++) {
+		threads.emplace_back([&, t]() {
+			partials[t] = sumRows(grid, detail * t / threadCount, detail * (t + 1) / threadCount);
+		});
+	}
+
+	partials[0] = sumRows(grid, 0, detail / threadCount);
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	ShapeMetrics metrics;
+	metrics.detail = detail;
+
+	for (const PartialSums& partial : partials) {
+		metrics.area += partial.area;
+		metrics.volume += partial.volume;
+	}
+
+	// Orientation decides the sign
+	metrics.volume = std::abs(metrics.volume);
+
+	// Every row is the column outline scaled by rc[i] (never negative, as cos(phi) isn't), so the grid's bounds follow
+	// from the column extremes without visiting every point
+	auto [minX, maxX] = std::minmax_element(grid.cx.begin(), grid.cx.end());
+	auto [minY, maxY] = std::minmax_element(grid.sy.begin(), grid.sy.end());
+	auto [minRc, maxRc] = std::minmax_element(grid.rc.begin(), grid.rc.end());
+	auto [minZ, maxZ] = std::minmax_element(grid.rz.begin(), grid.rz.end());
+
+	double lowX = std::min(*minX * *maxRc, *minX * *minRc);
+	double highX = std::max(*maxX * *maxRc, *maxX * *minRc);
+	double lowY = std::min(*minY * *maxRc, *minY * *minRc);
+	double highY = std::max(*maxY * *maxRc, *maxY * *minRc);
+
+	metrics.boundsMin = glm::vec3((float)lowX, (float)lowY, (float)*minZ);
+	metrics.boundsMax = glm::vec3((float)highX, (float)highY, (float)*maxZ);
+
+	metrics.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	return metrics;
+}
+
+void benchmarkShapeMetrics(const SupershapeParams& shape, size_t maxDetail) {
+	const size_t details[] = { 32, 100, 316, 1000, 3162, 10000 };
+
+	ShapeMetrics previous;
+
+	for (size_t detail : details) {
+		if (detail > maxDetail) {
+			break;
+		}
+
+		ShapeMetrics single = measureSupershape(shape, detail, 1);
+		ShapeMetrics metrics = measureSupershape(shape, detail);
+
+		LogLine line(LogLevel::Info);
+		line << "Detail " << detail << ": area " << metrics.area << ", volume " << metrics.volume << ", bounds (" << metrics.boundsMin.x
+			<< ", " << metrics.boundsMin.y << ", " << metrics.boundsMin.z << ") -> (" << metrics.boundsMax.x << ", " << metrics.boundsMax.y
+			<< ", " << metrics.boundsMax.z << "), " << single.milliseconds << " ms on 1 thread, " << metrics.milliseconds << " ms on all";
+
+		if (previous.detail > 0) {
+			line << " (area moved " << std::abs(metrics.area - previous.area) / metrics.area << ", volume "
+				<< std::abs(metrics.volume - previous.volume) / metrics.volume << ")";
+		}
+
+		previous = metrics;
+	}
+}
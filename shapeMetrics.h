@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+#include "struct.h"
+
+/*
+Surface area, enclosed volume and bounds of a supershape, measured on the same (theta, phi) grid and triangulation that
+generateMesh() builds - so at a given detail, the numbers describe exactly the surface being drawn. Both converge
+quadratically in the grid spacing as detail rises.
+
+Everything is in the shape's own unit-scale space (see gielis.h), before the model matrix.
+*/
+
+struct ShapeMetrics {
+	size_t detail = 0;
+
+	double area = 0.0;
+	double volume = 0.0;
+
+	glm::vec3 boundsMin{ 0.0f };
+	glm::vec3 boundsMax{ 0.0f };
+
+	float milliseconds = 0.0f;
+};
+
+// Rows of the grid are split between threadCount threads (0 = one per hardware thread). Throws for detail 0
+extern ShapeMetrics measureSupershape(const SupershapeParams& shape, size_t detail, uint32_t threadCount = 0);
+
+// Times measureSupershape() on one thread and on all of them at rising detail, printing how far each result moved
+extern void benchmarkShapeMetrics(const SupershapeParams& shape, size_t maxDetail = 10000);
@@ -0,0 +1,157 @@
+#include "startup.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <thread>
+
+StartupGraph::TaskId StartupGraph::addTask(const std::string& name, std::function<void()> function, const std::vector<TaskId>& dependencies, bool mainThreadOnly) {
+	Task task{};
+	task.name = name;
+	task.function = std::move(function);
+	task.remainingDependencies = dependencies.size();
+	task.mainThreadOnly = mainThreadOnly;
+
+	TaskId id = tasks.size();
+
+	for (TaskId dependency : dependencies) {
+		tasks[dependency].dependents.push_back(id); // Dependencies must be added first, so the graph can't have cycles
+	}
+
+	tasks.push_back(std::move(task));
+
+	return id;
+}
+
+void StartupGraph::pushReady(TaskId id) {
+	if (tasks[id].mainThreadOnly) {
+		readyMainThreadTasks.push_back(id);
+	}
+	else {
+		readyTasks.push_back(id);
+	}
+}
+
+void StartupGraph::run() {
+	startTime = std::chrono::high_resolution_clock::now();
+	unfinishedTasks = tasks.size();
+	runningTasks = 0;
+
+	for (TaskId id = 0; id < tasks.size(); id++) {
+		if (tasks[id].remainingDependencies == 0) {
+			pushReady(id);
+		}
+	}
+
+	// No point in more workers than tasks; worker 0 is the calling (main) thread
+	size_t workerCount = std::min<size_t>(std::max(2u, std::thread::hardware_concurrency()), tasks.size());
+
+	std::vector<std::thread> workers;
+
+	for (size_t i = 1; i < workerCount; i++) {
+		workers.emplace_back(&StartupGraph::workerLoop, this, i);
+	}
+
+	workerLoop(0);
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	totalMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+void StartupGraph::workerLoop(size_t worker) {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+		auto hasWork = [&]() {
+			return !error && (!readyTasks.empty() || (worker == 0 && !readyMainThreadTasks.empty()));
+		};
+
+		auto isDone = [&]() {
+			return unfinishedTasks == 0 || (error && runningTasks == 0);
+		};
+
+		taskReady.wait(lock, [&]() { return hasWork() || isDone(); });
+
+		if (!hasWork()) {
+			return;
+		}
+
+		// The main thread prefers the tasks only it can run
+		std::deque<TaskId>& queue = (worker == 0 && !readyMainThreadTasks.empty()) ? readyMainThreadTasks : readyTasks;
+		TaskId id = queue.front();
+		queue.pop_front();
+
+		runningTasks++;
+		lock.unlock();
+
+		float startMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		std::exception_ptr taskError;
+
+		try {
+			tasks[id].function();
+		}
+		catch (...) {
+			taskError = std::current_exception();
+		}
+
+		float endMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+		lock.lock();
+		runningTasks--;
+
+		Task& task = tasks[id];
+		task.startMs = startMs;
+		task.endMs = endMs;
+		task.worker = worker;
+		task.ran = true;
+
+		if (taskError) {
+			// Dependents never become ready; let the tasks already running finish, then bail out
+			if (!error) {
+				error = taskError;
+			}
+		}
+		else {
+			unfinishedTasks--;
+
+			for (TaskId dependent : task.dependents) {
+				if (--tasks[dependent].remainingDependencies == 0) {
+					pushReady(dependent);
+				}
+			}
+		}
+
+		taskReady.notify_all();
+	}
+}
+
+void StartupGraph::printTimeline() {
+	const int barWidth = 50;
+
+	LogLine(LogLevel::Info) << "Startup timeline (" << totalMs << " ms total):";
+
+	for (const Task& task : tasks) {
+		if (!task.ran) {
+			LogLine(LogLevel::Info) << "\t" << std::left << std::setw(22) << task.name << " did not run";
+			continue;
+		}
+
+		int barStart = totalMs > 0.0f ? (int)std::lround(task.startMs / totalMs * barWidth) : 0;
+		int barEnd = totalMs > 0.0f ? std::max(barStart + 1, (int)std::lround(task.endMs / totalMs * barWidth)) : barStart + 1;
+
+		std::string bar(barWidth, ' ');
+		std::fill(bar.begin() + std::min(barStart, barWidth - 1), bar.begin() + std::min(barEnd, barWidth), '#');
+
+		LogLine(LogLevel::Info) << "\t" << std::left << std::setw(22) << task.name << " [" << bar << "] "
+			<< std::right << std::fixed << std::setprecision(2)
+			<< std::setw(8) << task.startMs << " -> " << std::setw(8) << task.endMs << " ms (worker " << task.worker << ")";
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+Runs the independent stages of startup (mesh generation, shader loading, instance/device creation, pipeline creation...)
+concurrently. Each task starts as soon as all of its dependencies have finished; the calling thread joins in as a worker and
+is the only one allowed to run tasks marked mainThreadOnly (GLFW requires some calls to be made from the main thread).
+*/
+
+class StartupGraph {
+public:
+	typedef size_t TaskId;
+
+	TaskId addTask(const std::string& name, std::function<void()> function, const std::vector<TaskId>& dependencies = {}, bool mainThreadOnly = false);
+
+	// Blocks until every task has run; rethrows the first exception thrown by a task
+	void run();
+
+	void printTimeline();
+
+private:
+	struct Task {
+		std::string name;
+		std::function<void()> function;
+		std::vector<TaskId> dependents;
+		size_t remainingDependencies = 0;
+		bool mainThreadOnly = false;
+
+		// Timeline, relative to the start of run()
+		float startMs = 0.0f;
+		float endMs = 0.0f;
+		size_t worker = 0;
+		bool ran = false;
+	};
+
+	std::vector<Task> tasks;
+
+	std::mutex mutex;
+	std::condition_variable taskReady;
+	std::deque<TaskId> readyTasks;
+	std::deque<TaskId> readyMainThreadTasks;
+	size_t unfinishedTasks = 0;
+	size_t runningTasks = 0;
+	std::exception_ptr error;
+
+	std::chrono::high_resolution_clock::time_point startTime;
+	float totalMs = 0.0f;
+
+	void workerLoop(size_t worker);
+	void pushReady(TaskId id);
+};
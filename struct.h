@@ -4,6 +4,7 @@
 #include <optional>
 #include <vector>
 #include <array>
+#include <chrono>
 
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
@@ -14,6 +15,7 @@
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> transferFamily; // A transfer-only family if there is one, otherwise the graphics family
 
 	bool isComplete();
 };
@@ -55,11 +57,70 @@ struct Vertex {
 	}
 };
 
+// Gielis superformula parameters, shared by both angles (see supershape() in shader.vert)
+struct SupershapeParams {
+	float m = 0.0f;
+	float n1 = 0.2f;
+	float n2 = 1.7f;
+	float n3 = 1.7f;
+	float a = 1.0f;
+	float b = 1.0f;
+};
+
+// Per-frame data, one slot per frame in flight in the uniform ring (std140 layout)
 struct UniformBufferObject {
-	glm::mat4 model;
 	glm::mat4 view;
 	glm::mat4 proj;
 	float time;
+	alignas(16) SupershapeParams shape; // std140 aligns structs to 16 bytes
+};
+
+// Per-draw data, pushed straight into the command buffer
+struct PushConstants {
+	glm::mat4 model;
+	uint32_t sectors; // Instances the geometry is drawn as, see mesh.h
+	uint32_t sectorColumns;
+};
+
+// Input as it arrived from GLFW, queued for the render loop to apply in order just before it builds the view
+enum class InputEventType {
+	Key,
+	CursorMove
+};
+
+struct InputEvent {
+	InputEventType type;
+	std::chrono::steady_clock::time_point time;
+
+	int key;
+	int action;
+
+	float dx;
+	float dy;
+};
+
+// Raw GLFW input, handed from the event thread to the render thread, which records it and runs the handlers
+enum class WindowEventType {
+	Key,
+	Cursor,
+	MouseButton,
+	Refresh // The window was exposed or damaged
+};
+
+struct WindowEvent {
+	WindowEventType type;
+	std::chrono::steady_clock::time_point time;
+
+	int code; // Key or mouse button
+	int action;
+
+	float x;
+	float y;
+};
+
+struct FramebufferSize {
+	int width = 0;
+	int height = 0;
 };
 
 struct KeyControls {
@@ -69,6 +130,10 @@ struct KeyControls {
 	bool right = false;
 	bool down = false;
 	bool up = false;
+
+	bool any() const {
+		return forwards || backwards || left || right || down || up;
+	}
 };
 
 struct Camera {
@@ -83,37 +148,40 @@ struct Camera {
 	float phi;
 
 	float sensitivity = 0.001;
-	float speed = 0.001;
+	float speed = 1.5f; // World units per second
 
-	void updateEye() {
+	// Moves the eye by however far the held keys carry it in dt seconds
+	void updateEye(float dt) {
 		glm::vec3 forwards = direction;
 		forwards.z = 0;
 		forwards = glm::normalize(forwards);
 
 		glm::vec3 right = glm::cross(forwards, up);
 
+		float distance = speed * dt;
+
 		if (controls.forwards) {
-			eye += forwards * speed;
+			eye += forwards * distance;
 		}
 
 		if (controls.backwards) {
-			eye -= forwards * speed;
+			eye -= forwards * distance;
 		}
 
 		if (controls.right) {
-			eye += right * speed;
+			eye += right * distance;
 		}
 
 		if (controls.left) {
-			eye -= right * speed;
+			eye -= right * distance;
 		}
 
 		if (controls.down) {
-			eye.z -= speed;
+			eye.z -= distance;
 		}
 
 		if (controls.up) {
-			eye.z += speed;
+			eye.z += distance;
 		}
 	}
 
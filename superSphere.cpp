@@ -1,4 +1,5 @@
 #include "superSphere.h"
+#include "gielis.h"
 
 #include <random>
 
@@ -23,16 +24,155 @@ const bool enableValidationLayers = true;
 
 bool WIREFRAME = false;
 bool CULLBACK = true;
+bool DEPTH_BUFFER = true; // Depth testing, so early-Z can reject hidden fragments before they are shaded
+bool DYNAMIC_RESOLUTION = false; // Render at a reduced scale when the scene pass takes the GPU over TARGET_FRAME_TIME_MS, then upscale
+
+const float TARGET_FRAME_TIME_MS = 1000.0f / 60.0f;
+const float MIN_RENDER_SCALE = 0.5f;
+
+bool ON_DEMAND_RENDERING = true; // Only draw when something changed; otherwise the render thread sleeps until woken
+
+const double IDLE_WAIT_SECONDS = 0.5; // Upper bound on a single sleep, so background work is still picked up
+const float ACTIVITY_REPORT_SECONDS = 10.0f;
 
 const int MAX_FRAMES_IN_FLIGHT = 2; // 3+ could lead to extra latency
 
+const char* PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
+const VkDeviceSize GEOMETRY_UPLOAD_BUDGET = 8ull * 1024 * 1024; // Bytes of a new mesh handed to the transfer queue per frame
+
+// Store one slice of the sphere and draw it this many times, rotated - memory and mesh generation fall by the same factor.
+// Reduced to a divisor of the grid's column count when needed; 1 = the whole grid. See mesh.h
+const uint32_t GEOMETRY_SECTORS = 1;
+
+// Free a mesh's CPU copy as soon as its last byte is in staging memory, instead of once the GPU copy has completed - the
+// copy in staging makes it redundant, and a streamed mesh would otherwise be held twice for several frames
+const bool RELEASE_MESH_AFTER_UPLOAD = true;
+
+const float MEMORY_REPORT_SECONDS = 60.0f; // Host and device memory per subsystem, current and peak; 0 only reports at exit
+
+bool CAPTURE = false; // Copy presented frames back and encode them on worker threads
+const uint32_t CAPTURE_INTERVAL = 1; // Capture every Nth frame
+const bool CAPTURE_BLOCK = false; // With every readback buffer busy: stall the render loop (true) or drop the frame (false)
+const CaptureFormat CAPTURE_FORMAT = CaptureFormat::Png;
+const char* CAPTURE_DIRECTORY = "capture";
+const uint32_t CAPTURE_SLOTS = MAX_FRAMES_IN_FLIGHT + 4; // More than MAX_FRAMES_IN_FLIGHT, so blocking always ends
+
+bool PUBLISH_METRICS = true; // Live frame statistics in shared memory, see metrics.h and tools/metricsReader.cpp
+const char* METRICS_NAME = "/supersphere-metrics"; // The process id is appended, so several instances never share a block
+
+// Deterministic runs - record live input and the frame clock to a file, or replay one (instead of live input) and exit.
+// Replays write per-frame timing to <replay file>.timing.csv
+const char* RECORD_INPUT_FILE = nullptr;
+const char* REPLAY_INPUT_FILE = nullptr;
+const ReplayTiming REPLAY_TIMING = ReplayTiming::Recorded;
+const float REPLAY_TIMESTEP = 1.0f / 60.0f; // For ReplayTiming::FixedStep
+
+const LogLevel LOG_LEVEL = LogLevel::Info; // Debug also shows verbose validation output
+
+const Precision SHADER_PRECISION = Precision::Exact; // Superformula accuracy in the vertex shader and picking, see fastMath.h
+
+// External control of the shape and camera (controlPlane.h): "-" reads commands from stdin, anything else is the path of a
+// UNIX socket to listen on. Not recorded by RECORD_INPUT_FILE
+const char* CONTROL_SOURCE = nullptr;
+const uint32_t CONTROL_STRESS_RATE = 0; // Instead of a source: synthetic updates per second, checked for torn snapshots
+
 void SuperSphere::run() {
+	launchTime = std::chrono::high_resolution_clock::now();
+	setLogLevel(LOG_LEVEL);
+
 	initWindow();
-	createVertices();
-	createIndices();
 	initVulkan();
+
+	if (PUBLISH_METRICS) {
+		if (metricsPublisher.open(METRICS_NAME)) {
+			LogLine(LogLevel::Info) << "Publishing metrics as " << metricsPublisher.getName();
+		}
+		else {
+			LogLine(LogLevel::Warning) << "Failed to open shared memory " << metricsPublisher.getName() << " - metrics will not be published";
+		}
+	}
+
+	// The control thread only wakes the render thread - safe from any thread
+	if ((CONTROL_SOURCE != nullptr || CONTROL_STRESS_RATE > 0) && !controlPlane.start(CONTROL_SOURCE, CONTROL_STRESS_RATE, [this]() { renderWake.notify(); })) {
+		LogLine(LogLevel::Warning) << "Failed to start the control plane - the shape will only be animated";
+	}
+
 	mainLoop();
+	metricsPublisher.close();
+
+	if (controlPlane.isRunning()) {
+		controlPlane.stop();
+		controlPlane.printStatistics();
+	}
+
+	cleanup();
+
+	flushLog();
+}
+
+// Renders every job read from the stream (stdin, a pipe, a file) to <outputDirectory>/<name>.png, then returns
+void SuperSphere::runBatch(std::istream& jobs, const std::string& outputDirectory) {
+	launchTime = std::chrono::high_resolution_clock::now();
+	setLogLevel(LOG_LEVEL);
+
+	batchMode = true;
+	batchOutputDirectory = outputDirectory;
+
+	std::error_code error;
+	std::filesystem::create_directories(batchOutputDirectory, error);
+
+	initWindow();
+	initVulkan();
+	createBatchResources();
+
+	auto batchStart = std::chrono::high_resolution_clock::now();
+	uint64_t jobCount = 0;
+	uint64_t rejectedCount = 0;
+	uint64_t lineNumber = 0;
+
+	std::string line;
+
+	while (std::getline(jobs, line)) {
+		lineNumber++;
+
+		if (line.find_first_not_of(" \t\r") == std::string::npos) {
+			continue;
+		}
+
+		BatchJob job;
+		job.name = "job" + std::to_string(lineNumber);
+
+		std::string parseError;
+
+		if (!parseBatchJob(line, job, parseError)) {
+			LogLine(LogLevel::Warning) << "Batch line " << lineNumber << " rejected: " << parseError;
+			rejectedCount++;
+			continue;
+		}
+
+		renderBatchJob(job);
+		jobCount++;
+	}
+
+	// Write out whatever is still in flight
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		vkWaitForFences(device, 1, &inFlightFences[i], VK_TRUE, UINT64_MAX);
+		finishBatchJob(batchSlots[i]);
+	}
+
+	float batchSeconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - batchStart).count();
+	LogLine(LogLevel::Info) << "Batch: " << jobCount << " jobs in " << batchSeconds << " s (" << (batchSeconds > 0.0f ? jobCount / batchSeconds : 0.0f)
+		<< " jobs/s), " << rejectedCount << " rejected";
+
+	vkDeviceWaitIdle(device);
+	flushDeletionQueue(true);
+	reportMemory(true);
+
+	destroyBatchResources();
 	cleanup();
+
+	flushLog();
 }
 
 void SuperSphere::initWindow() {
@@ -40,64 +180,371 @@ void SuperSphere::initWindow() {
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
+	// Batch mode never shows anything - the window only exists so device selection and the swap chain work as usual
+	if (batchMode) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		window = glfwCreateWindow(64, 64, NAME, nullptr, nullptr);
+		glfwSetWindowUserPointer(window, this);
+		glfwGetFramebufferSize(window, &framebufferSize.width, &framebufferSize.height);
+
+		return;
+	}
+
 	//window = glfwCreateWindow(WIDTH, HEIGHT, NAME, nullptr, nullptr);
 	GLFWmonitor* monitor = glfwGetPrimaryMonitor();
 	const GLFWvidmode* mode = glfwGetVideoMode(monitor);
 	window = glfwCreateWindow(mode->width, mode->height, NAME, monitor, NULL);
 	glfwSetWindowUserPointer(window, this);
 	glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+	glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+
+	// Later sizes arrive through framebufferResizeCallback
+	glfwGetFramebufferSize(window, &framebufferSize.width, &framebufferSize.height);
 }
 
 void SuperSphere::initVulkan() {
-	createInstance();
-	setupDebugMessenger();
-	createSurface();
-	pickPhysicalDevice();
-	createLogicalDevice();
-	createSwapChain();
-	createImageViews();
-	createRenderPass();
-	createDescriptorSetLayout();
-	createGraphicsPipeline();
-	createFramebuffers();
-	createCommandPools();
-	createUnifiedBuffer();
+	// Everything up to the first buffer upload is split into independent stages which run concurrently
+	StartupGraph startup;
+
+	startup.addTask("generateMesh", [this]() { initialMesh = generateMesh(detail, radius, sectorCount(detail, GEOMETRY_SECTORS)); });
+	auto shaders = startup.addTask("loadShaders", [this]() { loadShaders(); });
+	auto cacheFile = startup.addTask("loadPipelineCacheFile", [this]() { loadPipelineCacheFile(); });
+	auto instance = startup.addTask("createInstance", [this]() { createInstance(); setupDebugMessenger(); });
+	auto surface = startup.addTask("createSurface", [this]() { createSurface(); }, { instance });
+	auto device = startup.addTask("createLogicalDevice", [this]() {
+		pickPhysicalDevice();
+		createLogicalDevice();
+		allocator.init(physicalDevice, this->device, memoryBudgetEnabled);
+		uploader.init(this->device, &allocator, transferQueue, queueFamilyIndices.transferFamily.value());
+	}, { surface });
+	auto cache = startup.addTask("createPipelineCache", [this]() { createPipelineCache(); }, { device, cacheFile });
+	auto swapChain = startup.addTask("createSwapChain", [this]() { createSwapChain(); createImageViews(); }, { device });
+	auto renderPass = startup.addTask("createRenderPass", [this]() { createRenderPass(); }, { swapChain });
+	auto layout = startup.addTask("createDescSetLayout", [this]() { createDescriptorSetLayout(); }, { device });
+	startup.addTask("createGraphicsPipeline", [this]() { createGraphicsPipeline(); }, { renderPass, layout, cache, shaders });
+	auto depth = startup.addTask("createRenderTargets", [this]() { createDepthResources(); createOffscreenTarget(); }, { renderPass });
+	startup.addTask("createFramebuffers", [this]() { createFramebuffers(); }, { renderPass, depth });
+	startup.addTask("createCommandPools", [this]() { createCommandPools(); }, { device });
+
+	startup.run();
+	startup.printTimeline();
+
+	// Joined - everything below needs the mesh and the device
+	createGeometry();
 	createCamera();
 	createUniformBuffers();
 	createDescriptorPool();
 	createDescriptorSets();
 	createCommandBuffers();
 	createSyncObjects();
+	createQueryPool();
+
+	if (DYNAMIC_RESOLUTION && !batchMode) {
+		createTimestampQueryPool();
+	}
+
+	if (CAPTURE && !batchMode) {
+		createCaptureResources();
+	}
+
+	allocator.printStatistics();
 }
 
+// Main thread: GLFW's event loop, which must stay here. Everything Vulkan runs on the render thread, so a blocking acquire,
+// fence wait or present never holds up input, and slow event handling never holds up a frame
 void SuperSphere::mainLoop() {
+	renderRunning.store(true, std::memory_order_release);
+
+	renderThread = std::thread([this]() {
+		try {
+			renderLoop();
+		}
+		catch (...) {
+			renderError = std::current_exception();
+		}
+
+		// However it stopped (a finished replay, an error), the event loop below has to stop too
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
+		glfwPostEmptyEvent();
+	});
+
 	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents(); // Deals with window events
-		drawFrame();
+		glfwWaitEvents();
+	}
+
+	renderRunning.store(false, std::memory_order_release);
+	renderWake.notify();
+	renderThread.join();
+
+	if (renderError) {
+		std::rethrow_exception(renderError);
+	}
+}
+
+void SuperSphere::renderLoop() {
+	activityStartTime = std::chrono::high_resolution_clock::now();
+	activityStartCpu = processCpuSeconds();
+	activityStartEnergy = packageEnergyJoules();
+
+	startRecordOrReplay();
+
+	while (renderRunning.load(std::memory_order_acquire)) {
+		auto frameStart = std::chrono::steady_clock::now();
+
+		takeWindowEvents();
+		updatePicking();
+
+		reportActivity();
+		reportMemory(false);
+
+		if (inputReplay.isReplaying()) {
+			if (inputReplay.finished((uint32_t)frameCount)) {
+				break;
+			}
+
+			injectReplayInput();
+		}
+
+		// Nothing on screen would change - present nothing and sleep until woken. A replay draws every frame
+		if (ON_DEMAND_RENDERING && !inputReplay.isReplaying() && !needsRedraw()) {
+			auto idleStart = std::chrono::high_resolution_clock::now();
+			renderWake.waitFor(std::chrono::duration<double>(IDLE_WAIT_SECONDS));
+			activityIdleSeconds += std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - idleStart).count();
+
+			continue;
+		}
+
+		redrawRequested = false;
+
+		// A frame dropped for a swap chain recreation takes no frame number, so recorded frames are numbered without gaps
+		if (!drawFrame()) {
+			continue;
+		}
+
 		frameCount++;
+		activityFrames++;
+
+		float frameMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+		publishMetrics(frameMs);
+
+		renderFrameMsSum += frameMs;
+		renderFrameMsMax = std::max(renderFrameMsMax, frameMs);
+		renderFrameCount++;
+
+		if (inputReplay.isReplaying()) {
+			inputReplay.addTiming((uint32_t)frameCount - 1, frameMs, fenceWaitMs);
+		}
+
+		if (frameCount == 1) {
+			float firstFrameTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - launchTime).count();
+			LogLine(LogLevel::Info) << "Time to first frame: " << firstFrameTime << " ms";
+		}
 	}
 
+	reportThreadTiming(std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - activityStartTime).count());
+
 	vkDeviceWaitIdle(device);
+
+	flushDeletionQueue(true);
+
+	finishRecordOrReplay();
+	reportMemory(true);
+
+	if (CAPTURE) {
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			collectCapture(i);
+		}
+
+		frameCapture.stop();
+		frameCapture.printStatistics();
+	}
+}
+
+// Both start the clock from here, with the camera and animation in their initial state
+void SuperSphere::startRecordOrReplay() {
+	auto origin = std::chrono::steady_clock::now();
+
+	if (REPLAY_INPUT_FILE != nullptr) {
+		if (!inputReplay.load(REPLAY_INPUT_FILE, REPLAY_TIMING, REPLAY_TIMESTEP)) {
+			throw std::runtime_error("Failed to load input replay!");
+		}
+
+		inputReplay.start(origin);
+		LogLine(LogLevel::Info) << "Replaying " << REPLAY_INPUT_FILE;
+	}
+	else if (RECORD_INPUT_FILE != nullptr) {
+		inputRecorder.start(origin);
+		LogLine(LogLevel::Info) << "Recording input to " << RECORD_INPUT_FILE;
+	}
+
+	lastCameraTime = origin;
+	lastAnimationTime = origin;
+}
+
+void SuperSphere::finishRecordOrReplay() {
+	if (inputReplay.isReplaying()) {
+		inputReplay.writeTimings(std::string(REPLAY_INPUT_FILE) + ".timing.csv");
+	}
+
+	if (inputRecorder.isRecording()) {
+		if (inputRecorder.save(RECORD_INPUT_FILE)) {
+			LogLine(LogLevel::Info) << "Recorded " << inputRecorder.getRecordCount() << " events over " << frameCount << " frames to " << RECORD_INPUT_FILE;
+		}
+		else {
+			LogLine(LogLevel::Warning) << "Failed to write " << RECORD_INPUT_FILE << "!";
+		}
+	}
+}
+
+// Through the same handlers live input takes, before the frame it arrived before when recorded
+void SuperSphere::injectReplayInput() {
+	for (const ReplayRecord& input : inputReplay.takeInputs((uint32_t)frameCount)) {
+		auto time = inputReplay.toTime(input.timeNs);
+
+		switch (input.type) {
+		case ReplayRecordType::Key:
+			handleKey(input.code, input.action, time);
+			break;
+
+		case ReplayRecordType::Cursor:
+			handleCursor(input.dx, input.dy, time);
+			break;
+
+		case ReplayRecordType::MouseButton:
+			handleMouseButton(input.code, input.action);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+// The one time sample a frame's camera and animation are advanced to - recorded, or taken from a replay
+std::chrono::steady_clock::time_point SuperSphere::frameClock() {
+	if (inputReplay.isReplaying()) {
+		return inputReplay.frameTime((uint32_t)frameCount);
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	inputRecorder.add(ReplayRecordType::Frame, (uint32_t)frameCount, now);
+
+	return now;
+}
+
+// Plain stores into the mapped block - cheap enough to run every frame
+void SuperSphere::publishMetrics(float frameMs) {
+	if (!metricsPublisher.isOpen()) {
+		return;
+	}
+
+	const GeometrySlot& geometry = geometrySlots[activeGeometry];
+
+	MetricsData data{};
+	data.frameCount = frameCount;
+	data.presentMode = (uint32_t)swapChainPresentMode;
+	data.detail = (uint32_t)detail;
+	data.width = swapChainExtent.width;
+	data.height = swapChainExtent.height;
+	data.deviceAllocations = allocator.getDeviceAllocationCount();
+	// Drawn counts - only one sector is stored, the instances repeat it around the axis
+	data.vertexCount = geometry.indexOffset / sizeof(Vertex) * geometry.sectors;
+	data.indexCount = (uint64_t)geometry.indexCount * geometry.sectors;
+	data.deviceMemoryReserved = allocator.getReservedBytes();
+	data.deviceMemoryUsed = allocator.getUsedBytes();
+
+	metricsPublisher.publish(frameMs, fenceWaitMs, data);
+}
+
+// Anything that changes the next frame: input, held movement keys, the animation, or a detail change still in progress
+bool SuperSphere::needsRedraw() {
+	bool geometryBusy = meshJob.valid() || geometryUploading || requestedDetail != detail;
+
+	return redrawRequested || !inputQueue.empty() || camera.controls.any() || !animationPaused || geometryBusy || framebufferResized
+		|| controlPlane.pending();
+}
+
+void SuperSphere::reportActivity() {
+	auto now = std::chrono::high_resolution_clock::now();
+	float wallSeconds = std::chrono::duration<float>(now - activityStartTime).count();
+
+	if (wallSeconds < ACTIVITY_REPORT_SECONDS) {
+		return;
+	}
+
+	double cpu = processCpuSeconds();
+	double energy = packageEnergyJoules();
+
+	// Submitted when it goes out of scope, before the thread timing lines
+	{
+		LogLine report(LogLevel::Info);
+		report << "Last " << wallSeconds << " s: " << activityFrames << " frames, idle " << (int)std::round(100.0f * activityIdleSeconds / wallSeconds)
+			<< "% of the time, CPU " << (int)std::round(100.0 * (cpu - activityStartCpu) / wallSeconds) << "% of a core";
+
+		if (energy >= 0.0 && activityStartEnergy >= 0.0 && energy >= activityStartEnergy) {
+			report << ", CPU package " << (energy - activityStartEnergy) / wallSeconds << " W";
+		}
+	}
+
+	reportThreadTiming(wallSeconds);
+
+	activityStartTime = now;
+	activityStartCpu = cpu;
+	activityStartEnergy = energy;
+	activityIdleSeconds = 0.0f;
+	activityFrames = 0;
+}
+
+void SuperSphere::reportMemory(bool force) {
+	auto now = std::chrono::steady_clock::now();
+
+	if (!force && (MEMORY_REPORT_SECONDS <= 0.0f || std::chrono::duration<float>(now - memoryReportTime).count() < MEMORY_REPORT_SECONDS)) {
+		return;
+	}
+
+	memoryReportTime = now;
+
+	allocator.reportUsage();
+	reportHostMemory();
 }
 
 void SuperSphere::cleanup() {
 	cleanupSwapChain();
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-		vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+	destroyBuffer(uniformRing, uniformRingAllocation);
+
+	for (CaptureBuffer& captureBuffer : captureBuffers) {
+		if (captureBuffer.buffer != VK_NULL_HANDLE) {
+			destroyBuffer(captureBuffer.buffer, captureBuffer.allocation);
+		}
 	}
 
 	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-	vkDestroyBuffer(device, unifiedBuffer, nullptr);
-	vkFreeMemory(device, unifiedBufferMemory, nullptr);
+	// A mesh or BVH still being built is finished and dropped
+	if (meshJob.valid()) {
+		meshJob.wait();
+	}
+
+	if (pickingJob.valid()) {
+		pickingJob.wait();
+	}
+
+	for (GeometrySlot& slot : geometrySlots) {
+		if (slot.buffer != VK_NULL_HANDLE) {
+			destroyBuffer(slot.buffer, slot.allocation);
+		}
+	}
 
 	vkDestroyPipeline(device, graphicsPipeline, nullptr);
+	vkDestroyPipeline(device, overdrawPipeline, nullptr);
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
+	savePipelineCache();
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
 	vkDestroyRenderPass(device, renderPass, nullptr);
 
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -107,7 +554,17 @@ void SuperSphere::cleanup() {
 	}
 
 	vkDestroyCommandPool(device, commandPool, nullptr);
-	vkDestroyCommandPool(device, transferCommandPool, nullptr);
+
+	if (statisticsQueryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(device, statisticsQueryPool, nullptr);
+	}
+
+	if (timestampQueryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+	}
+
+	uploader.destroy();
+	allocator.destroy();
 
 	vkDestroyDevice(device, nullptr);
 
@@ -143,6 +600,24 @@ void SuperSphere::createSwapChain() {
 	createInfo.imageExtent = extent;
 	createInfo.imageArrayLayers = 1;
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+	// With dynamic resolution the swapchain image is only ever the destination of the upscaling blit
+	if (DYNAMIC_RESOLUTION) {
+		if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+			throw std::runtime_error("Swap chain images can't be blitted to, which dynamic resolution needs!");
+		}
+
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+
+	// Captured frames are copied straight out of the swapchain image, after everything else has drawn into it
+	if (CAPTURE) {
+		if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+			throw std::runtime_error("Swap chain images can't be copied from, which frame capture needs!");
+		}
+
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
   
 	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 	uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
@@ -161,8 +636,9 @@ void SuperSphere::createSwapChain() {
 	createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
+	swapChainPresentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = swapChain; // Null on the first call; on recreation lets the driver hand over resources
 
 	if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create swap chain!");
@@ -226,12 +702,9 @@ VkExtent2D SuperSphere::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabil
 		return capabilities.currentExtent;
 	}
 	else {
-		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
-
 		VkExtent2D actualExtent = {
-			static_cast<uint32_t>(width),
-			static_cast<uint32_t>(height)
+			static_cast<uint32_t>(framebufferSize.width),
+			static_cast<uint32_t>(framebufferSize.height)
 		};
     
 		actualExtent.width = std::clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
@@ -275,16 +748,24 @@ void SuperSphere::createLogicalDevice() {
 	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
 
-	float queuePriority = 1.0f;
+	// Without a dedicated transfer family, uploads still get their own queue if the graphics family has a spare one
+	bool separateTransferQueue = indices.transferFamily == indices.graphicsFamily && queueFamilies[indices.graphicsFamily.value()].queueCount > 1;
+
+	float queuePriorities[] = { 1.0f, 1.0f };
 
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
 		VkDeviceQueueCreateInfo queueCreateInfo{};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = queueFamily;
-		queueCreateInfo.queueCount = 1;
-		queueCreateInfo.pQueuePriorities = &queuePriority;
+		queueCreateInfo.queueCount = (separateTransferQueue && queueFamily == indices.graphicsFamily.value()) ? 2 : 1;
+		queueCreateInfo.pQueuePriorities = queuePriorities;
 
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
@@ -292,14 +773,36 @@ void SuperSphere::createLogicalDevice() {
 	VkPhysicalDeviceFeatures deviceFeatures;
 	vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
 
+	// Timeline semaphores track upload completion
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+	vulkan12Features.timelineSemaphore = VK_TRUE;
+
 	// Main logical device creation
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &vulkan12Features;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	// The memory budget is only reported, so it is enabled where available rather than required
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions) {
+		if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+			enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			memoryBudgetEnabled = true;
+		}
+	}
+
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
   
 	if (enableValidationLayers) {
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -315,6 +818,16 @@ void SuperSphere::createLogicalDevice() {
 
 	vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 	vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+	vkGetDeviceQueue(device, indices.transferFamily.value(), separateTransferQueue ? 1 : 0, &transferQueue);
+
+	// With neither a transfer family nor a spare graphics queue, transferQueue is graphicsQueue itself - intended, and safe:
+	// uploads are only ever flushed from the thread that submits frames (a VkQueue needs external synchronisation), each
+	// flush is submitted before any frame waits for its timeline value, and one family needs no ownership transfers
+
+	queueFamilyIndices = indices;
+
+	LogLine(LogLevel::Info) << "Uploads use queue family " << indices.transferFamily.value()
+		<< (indices.transferFamily != indices.graphicsFamily ? " (dedicated transfer)" : (separateTransferQueue ? " (second graphics queue)" : " (shared with graphics)"));
 }
 
 QueueFamilyIndices SuperSphere::findQueueFamilies(VkPhysicalDevice device) {
@@ -346,6 +859,20 @@ QueueFamilyIndices SuperSphere::findQueueFamilies(VkPhysicalDevice device) {
 		i++;
 	}
 
+	// Prefer a transfer-only family - usually backed by dedicated DMA engines that run alongside rendering
+	for (uint32_t j = 0; j < queueFamilyCount; j++) {
+		bool transferOnly = (queueFamilies[j].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilies[j].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+
+		if (transferOnly) {
+			indices.transferFamily = j;
+			break;
+		}
+	}
+
+	if (!indices.transferFamily.has_value()) {
+		indices.transferFamily = indices.graphicsFamily;
+	}
+
 	return indices;
 }
 
@@ -382,7 +909,15 @@ bool SuperSphere::isDeviceSuitable(VkPhysicalDevice device) {
 	VkPhysicalDeviceFeatures deviceFeatures;
 	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
-	bool featuresAdequate = deviceFeatures.fillModeNonSolid == VK_TRUE;
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+
+	VkPhysicalDeviceFeatures2 deviceFeatures2{};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures2.pNext = &vulkan12Features;
+	vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+	bool featuresAdequate = deviceFeatures.fillModeNonSolid == VK_TRUE && vulkan12Features.timelineSemaphore == VK_TRUE;
 
 	return indices.isComplete() && extensionsSupported && swapChainAdequate && featuresAdequate;
 }
@@ -435,9 +970,9 @@ bool SuperSphere::checkValidationLayerSupport() {
 	std::vector<VkLayerProperties> availableLayers(layerCount);
 	vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
 
-	std::cout << "Available layers: " << std::endl;
+	LogLine(LogLevel::Debug) << "Available layers: ";
 	for (const auto& layerProperties : availableLayers) {
-		std::cout << "\t" << layerProperties.layerName << std::endl;
+		LogLine(LogLevel::Debug) << "\t" << layerProperties.layerName;
 	}
 
 	for (const char* layerName : validationLayers) {
@@ -526,11 +1061,26 @@ void SuperSphere::setupDebugMessenger() {
 }
 
 void SuperSphere::createGraphicsPipeline() {
-	auto vertShaderCode = readFile("shaders/vert.spv");
-	auto fragShaderCode = readFile("shaders/frag.spv");
+	VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+	VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+
+	// The code is released whether or not the modules could be created - it is never needed again
+	try {
+		vertShaderModule = createShaderModule(vertShaderCode);
+		fragShaderModule = createShaderModule(fragShaderCode);
+	}
+	catch (...) {
+		if (vertShaderModule != VK_NULL_HANDLE) {
+			vkDestroyShaderModule(device, vertShaderModule, nullptr);
+		}
 
-	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+		releaseShaderCode(vertShaderCode);
+		releaseShaderCode(fragShaderCode);
+		throw;
+	}
+
+	releaseShaderCode(vertShaderCode);
+	releaseShaderCode(fragShaderCode);
 
 	// Logic
 	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
@@ -539,6 +1089,22 @@ void SuperSphere::createGraphicsPipeline() {
 	vertShaderStageInfo.module = vertShaderModule;
 	vertShaderStageInfo.pName = "main";
 
+	// The vertex shader's PRECISION specialisation constant picks the superformula tier
+	int32_t precision = (int32_t)SHADER_PRECISION;
+
+	VkSpecializationMapEntry precisionEntry{};
+	precisionEntry.constantID = 0;
+	precisionEntry.offset = 0;
+	precisionEntry.size = sizeof(precision);
+
+	VkSpecializationInfo precisionSpecialization{};
+	precisionSpecialization.mapEntryCount = 1;
+	precisionSpecialization.pMapEntries = &precisionEntry;
+	precisionSpecialization.dataSize = sizeof(precision);
+	precisionSpecialization.pData = &precision;
+
+	vertShaderStageInfo.pSpecializationInfo = &precisionSpecialization;
+
 	VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
 	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -546,6 +1112,23 @@ void SuperSphere::createGraphicsPipeline() {
 	fragShaderStageInfo.pName = "main";
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+
+	// Overdraw variant - the fragment shader's OVERDRAW specialisation constant switches it to a flat additive colour
+	VkBool32 overdraw = VK_TRUE;
+
+	VkSpecializationMapEntry overdrawEntry{};
+	overdrawEntry.constantID = 0;
+	overdrawEntry.offset = 0;
+	overdrawEntry.size = sizeof(overdraw);
+
+	VkSpecializationInfo overdrawSpecialization{};
+	overdrawSpecialization.mapEntryCount = 1;
+	overdrawSpecialization.pMapEntries = &overdrawEntry;
+	overdrawSpecialization.dataSize = sizeof(overdraw);
+	overdrawSpecialization.pData = &overdraw;
+
+	VkPipelineShaderStageCreateInfo overdrawShaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+	overdrawShaderStages[1].pSpecializationInfo = &overdrawSpecialization;
   
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 
@@ -600,6 +1183,14 @@ void SuperSphere::createGraphicsPipeline() {
 	multisampling.pSampleMask = nullptr; // Optional
 	multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
 	multisampling.alphaToOneEnable = VK_FALSE; // Optional
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = DEPTH_BUFFER ? VK_TRUE : VK_FALSE;
+	depthStencil.depthWriteEnable = DEPTH_BUFFER ? VK_TRUE : VK_FALSE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.stencilTestEnable = VK_FALSE;
   
 	VkPipelineColorBlendAttachmentState colourBlendAttachment{};
 	colourBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
@@ -623,6 +1214,17 @@ void SuperSphere::createGraphicsPipeline() {
 	colourBlending.blendConstants[2] = 0.0f; // Optional
 	colourBlending.blendConstants[3] = 0.0f; // Optional
 
+	// Every shaded fragment adds to the pixel, so brightness shows how many layers were shaded there
+	VkPipelineColorBlendAttachmentState overdrawBlendAttachment = colourBlendAttachment;
+	overdrawBlendAttachment.blendEnable = VK_TRUE;
+	overdrawBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	overdrawBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	overdrawBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	overdrawBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+
+	VkPipelineColorBlendStateCreateInfo overdrawBlending = colourBlending;
+	overdrawBlending.pAttachments = &overdrawBlendAttachment;
+
 	std::vector<VkDynamicState> dynamicStates = {
 		VK_DYNAMIC_STATE_VIEWPORT,
 		VK_DYNAMIC_STATE_SCISSOR
@@ -638,8 +1240,13 @@ void SuperSphere::createGraphicsPipeline() {
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutInfo.setLayoutCount = 1; // Optional
 	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout; // Optional
-	pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-	pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create pipeline layout!");
@@ -655,56 +1262,191 @@ void SuperSphere::createGraphicsPipeline() {
 	pipelineInfo.pViewportState = &viewportState;
 	pipelineInfo.pRasterizationState = &rasteriser;
 	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colourBlending;
 	pipelineInfo.pDynamicState = &dynamicState;
 	pipelineInfo.layout = pipelineLayout;
 	pipelineInfo.renderPass = renderPass;
 	pipelineInfo.subpass = 0;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+	VkGraphicsPipelineCreateInfo overdrawPipelineInfo = pipelineInfo;
+	overdrawPipelineInfo.pStages = overdrawShaderStages;
+	overdrawPipelineInfo.pColorBlendState = &overdrawBlending;
+
+	VkGraphicsPipelineCreateInfo pipelineInfos[] = { pipelineInfo, overdrawPipelineInfo };
+	VkPipeline pipelines[2];
+
+	auto pipelineStart = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 2, pipelineInfos, nullptr, pipelines) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create graphics pipeline!");
 	}
+
+	graphicsPipeline = pipelines[0];
+	overdrawPipeline = pipelines[1];
+
+	float pipelineTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - pipelineStart).count();
+	LogLine(LogLevel::Info) << "Graphics pipeline created in " << pipelineTime << " ms (" << (pipelineCacheWarm ? "warm" : "cold") << " cache)";
   
 	vkDestroyShaderModule(device, vertShaderModule, nullptr);
 	vkDestroyShaderModule(device, fragShaderModule, nullptr);
 }
 
-VkShaderModule SuperSphere::createShaderModule(const std::vector<char>& code) {
-	VkShaderModuleCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+// Needs no device, so it can run while the instance and device are being created
+void SuperSphere::loadPipelineCacheFile() {
+	std::ifstream file(PIPELINE_CACHE_FILE, std::ios::ate | std::ios::binary);
 
-	VkShaderModule shaderModule;
+	if (file.is_open()) {
+		pipelineCacheData.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read(pipelineCacheData.data(), pipelineCacheData.size());
+		file.close();
+	}
+}
 
-	if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create shader module!");
+// Seeds the pipeline cache with the data from disk, if it was written by this exact device + driver
+void SuperSphere::createPipelineCache() {
+	std::vector<char> cacheData = std::move(pipelineCacheData);
+
+	pipelineCacheWarm = !cacheData.empty() && isPipelineCacheCompatible(cacheData);
+
+	if (!cacheData.empty() && !pipelineCacheWarm) {
+		LogLine(LogLevel::Info) << "Discarding stale pipeline cache " << PIPELINE_CACHE_FILE;
 	}
 
-	return shaderModule;
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = pipelineCacheWarm ? cacheData.size() : 0;
+	createInfo.pInitialData = pipelineCacheWarm ? cacheData.data() : nullptr;
+
+	if (vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline cache!");
+	}
 }
 
-void SuperSphere::createRenderPass() {
-	VkAttachmentDescription colourAttachment{};
-	colourAttachment.format = swapChainImageFormat;
-	colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+// Drivers should reject foreign caches themselves, but not all do - check the header against this device first
+bool SuperSphere::isPipelineCacheCompatible(const std::vector<char>& cacheData) {
+	VkPipelineCacheHeaderVersionOne header{};
+
+	if (cacheData.size() < sizeof(header)) {
+		return false;
+	}
+
+	memcpy(&header, cacheData.data(), sizeof(header));
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	return header.headerSize >= sizeof(header) &&
+		header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		header.vendorID == properties.vendorID &&
+		header.deviceID == properties.deviceID &&
+		memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// Written to a temporary file and renamed over the old cache, so a crash mid-write never leaves a corrupt cache behind
+void SuperSphere::savePipelineCache() {
+	size_t cacheSize = 0;
+	vkGetPipelineCacheData(device, pipelineCache, &cacheSize, nullptr);
+
+	std::vector<char> cacheData(cacheSize);
+
+	if (cacheSize == 0 || vkGetPipelineCacheData(device, pipelineCache, &cacheSize, cacheData.data()) != VK_SUCCESS) {
+		LogLine(LogLevel::Warning) << "Failed to read back pipeline cache!";
+		return;
+	}
+
+	std::string tempFile = std::string(PIPELINE_CACHE_FILE) + ".tmp";
+	std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+	file.write(cacheData.data(), cacheSize);
+	file.close();
+
+	if (!file) {
+		LogLine(LogLevel::Warning) << "Failed to write pipeline cache!";
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempFile, PIPELINE_CACHE_FILE, error);
+
+	if (error) {
+		LogLine(LogLevel::Warning) << "Failed to replace pipeline cache: " << error.message();
+	}
+}
+
+void SuperSphere::loadShaders() {
+	vertShaderCode = loadVertexShaderCode();
+
+	try {
+		fragShaderCode = loadFragmentShaderCode();
+	}
+	catch (...) {
+		releaseShaderCode(vertShaderCode);
+		throw;
+	}
+}
+
+VkShaderModule SuperSphere::createShaderModule(const ShaderCode& shaderCode) {
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = shaderCode.size;
+	createInfo.pCode = shaderCode.code;
+
+	VkShaderModule shaderModule;
+
+	if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shader module!");
+	}
+
+	return shaderModule;
+}
+
+void SuperSphere::createRenderPass() {
+	depthFormat = findDepthFormat();
+
+	renderPass = buildRenderPass(DYNAMIC_RESOLUTION ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+}
+
+// Render passes differing only in the final colour layout are compatible, so every variant works with the same pipelines -
+// which is why the dependencies are the same for all of them, including the ones only an offscreen target needs (ending in
+// TRANSFER_SRC_OPTIMAL, it gets copied out afterwards). For a swap chain image they only add a little transfer-stage sync
+VkRenderPass SuperSphere::buildRenderPass(VkImageLayout colourFinalLayout) {
+	VkAttachmentDescription colourAttachment{};
+	colourAttachment.format = swapChainImageFormat;
+	colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colourAttachment.finalLayout = colourFinalLayout;
 
 	// Attachment references - specify how image attachments are used (for example, we are using it for rendering colour)
 	VkAttachmentReference colourAttachmentRef{};
 	colourAttachmentRef.attachment = 0;
 	colourAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+	// Depth is cleared every frame and never read back, so it needn't be stored
+	VkAttachmentDescription depthAttachment{};
+	depthAttachment.format = depthFormat;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentRef{};
+	depthAttachmentRef.attachment = 1;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
 	// Subpass
 	VkSubpassDescription subpass{};
 	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colourAttachmentRef;
+	subpass.pDepthStencilAttachment = DEPTH_BUFFER ? &depthAttachmentRef : nullptr;
 
 	VkSubpassDependency dependency{};
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
@@ -716,32 +1458,84 @@ void SuperSphere::createRenderPass() {
 	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+	// The single depth image is shared by all frames in flight - the previous frame's depth writes must finish first
+	if (DEPTH_BUFFER) {
+		dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	}
+
+	// An offscreen target is shared by all frames in flight too - the previous frame's copy must have read it first
+	dependency.srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	// ...and this frame's colour writes must land before it is copied out
+	VkSubpassDependency blitDependency{};
+	blitDependency.srcSubpass = 0;
+	blitDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+	blitDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	blitDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	blitDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	blitDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	VkSubpassDependency dependencies[] = { dependency, blitDependency };
+
+	VkAttachmentDescription attachments[] = { colourAttachment, depthAttachment };
+
 	VkRenderPassCreateInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &colourAttachment;
+	renderPassInfo.attachmentCount = DEPTH_BUFFER ? 2 : 1;
+	renderPassInfo.pAttachments = attachments;
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
+	renderPassInfo.dependencyCount = 2;
+	renderPassInfo.pDependencies = dependencies;
 
-	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+	VkRenderPass newRenderPass;
+
+	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &newRenderPass) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create render pass!");
 	}
+
+	return newRenderPass;
 }
 
 void SuperSphere::createFramebuffers() {
+	// Everything is drawn into the offscreen target instead, which needs just the one framebuffer
+	if (DYNAMIC_RESOLUTION) {
+		VkImageView attachments[] = {
+			offscreenImageView,
+			depthImageView
+		};
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = DEPTH_BUFFER ? 2 : 1;
+		framebufferInfo.pAttachments = attachments;
+		framebufferInfo.width = swapChainExtent.width;
+		framebufferInfo.height = swapChainExtent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &offscreenFramebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create framebuffer!");
+		}
+
+		return;
+	}
+
 	swapChainFramebuffers.resize(swapChainImageViews.size());
 
 	for (size_t i = 0; i < swapChainImageViews.size(); i++) {
 		VkImageView attachments[] = {
-			swapChainImageViews[i]
+			swapChainImageViews[i],
+			depthImageView
 		};
 
 		VkFramebufferCreateInfo framebufferInfo{};
 		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		framebufferInfo.renderPass = renderPass;
-		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.attachmentCount = DEPTH_BUFFER ? 2 : 1;
 		framebufferInfo.pAttachments = attachments;
 		framebufferInfo.width = swapChainExtent.width;
 		framebufferInfo.height = swapChainExtent.height;
@@ -753,6 +1547,299 @@ void SuperSphere::createFramebuffers() {
 	}
 }
 
+// Prefers a depth-only format; the stencil formats are fallbacks
+VkFormat SuperSphere::findDepthFormat() {
+	const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
+
+	for (VkFormat format : candidates) {
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+		if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+			return format;
+		}
+	}
+
+	throw std::runtime_error("Failed to find a supported depth format!");
+}
+
+void SuperSphere::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, MemoryPurpose purpose, VkImage& image, Allocation& allocation) {
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = width;
+	imageInfo.extent.height = height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = format;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = usage;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create image!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+	// Optimal images get their own pools, so they never share a page with buffers
+	allocation = allocator.allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, purpose, AllocationLifetime::Persistent, true);
+
+	vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+}
+
+VkImageView SuperSphere::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) {
+	VkImageViewCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	createInfo.image = image;
+	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	createInfo.format = format;
+	createInfo.subresourceRange.aspectMask = aspectFlags;
+	createInfo.subresourceRange.baseMipLevel = 0;
+	createInfo.subresourceRange.levelCount = 1;
+	createInfo.subresourceRange.baseArrayLayer = 0;
+	createInfo.subresourceRange.layerCount = 1;
+
+	VkImageView imageView;
+
+	if (vkCreateImageView(device, &createInfo, nullptr, &imageView) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create image view!");
+	}
+
+	return imageView;
+}
+
+void SuperSphere::destroyImage(VkImage& image, VkImageView& imageView, Allocation& allocation) {
+	if (image == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vkDestroyImageView(device, imageView, nullptr);
+	vkDestroyImage(device, image, nullptr);
+	allocator.free(allocation);
+
+	image = VK_NULL_HANDLE;
+	imageView = VK_NULL_HANDLE;
+}
+
+void SuperSphere::createDepthResources() {
+	if (!DEPTH_BUFFER) {
+		return;
+	}
+
+	createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, MemoryPurpose::Attachments, depthImage, depthImageAllocation);
+	depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+}
+
+// Allocated at the full swap chain size, so changing the render scale never reallocates anything
+void SuperSphere::createOffscreenTarget() {
+	if (!DYNAMIC_RESOLUTION) {
+		return;
+	}
+
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChainImageFormat, &properties);
+
+	if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) || !(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
+		throw std::runtime_error("Swap chain format can't be blitted, which dynamic resolution needs!");
+	}
+
+	createImage(swapChainExtent.width, swapChainExtent.height, swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, MemoryPurpose::Attachments, offscreenImage, offscreenImageAllocation);
+	offscreenImageView = createImageView(offscreenImage, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+// The part of the render targets actually drawn to this frame - always anchored at the top-left corner
+VkExtent2D SuperSphere::getRenderExtent() {
+	if (!DYNAMIC_RESOLUTION) {
+		return swapChainExtent;
+	}
+
+	VkExtent2D extent{};
+	extent.width = std::max(1u, static_cast<uint32_t>(swapChainExtent.width * renderScale));
+	extent.height = std::max(1u, static_cast<uint32_t>(swapChainExtent.height * renderScale));
+
+	return extent;
+}
+
+// Pixel cost scales with the square of the render scale, so the scale follows the square root of the time ratio. Driven by the
+// GPU time of the scene pass - the CPU frame interval is pinned to the refresh rate under FIFO, so it would never show the
+// headroom to scale back up. Called after this frame's fence wait, so the slot's timestamps from last time are available
+void SuperSphere::updateRenderScale() {
+	float frameMs;
+
+	if (timestampQueryPool != VK_NULL_HANDLE) {
+		if (!timestampsWritten[currentFrame]) {
+			return;
+		}
+
+		timestampsWritten[currentFrame] = false;
+
+		uint64_t timestamps[2];
+
+		if (vkGetQueryPoolResults(device, timestampQueryPool, currentFrame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			return;
+		}
+
+		frameMs = (float)((double)((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriodNs / 1000000.0);
+	}
+	else {
+		// No timestamps on this queue - the frame interval is the best there is
+		auto now = std::chrono::high_resolution_clock::now();
+		frameMs = std::chrono::duration<float, std::milli>(now - lastRenderScaleTime).count();
+		lastRenderScaleTime = now;
+
+		// The first frame, and the ones straight after a stall (e.g. a minimised window), say nothing about the GPU load
+		if (frameMs > 250.0f) {
+			return;
+		}
+	}
+
+	smoothedFrameMs = smoothedFrameMs > 0.0f ? smoothedFrameMs + (frameMs - smoothedFrameMs) * 0.1f : frameMs;
+
+	// A dead band around the target stops the scale from hunting back and forth
+	if (smoothedFrameMs > TARGET_FRAME_TIME_MS * 1.05f || smoothedFrameMs < TARGET_FRAME_TIME_MS * 0.85f) {
+		float step = std::clamp(std::sqrt(TARGET_FRAME_TIME_MS / smoothedFrameMs), 0.95f, 1.02f); // Back off faster than we ramp up
+		renderScale = std::clamp(renderScale * step, MIN_RENDER_SCALE, 1.0f);
+	}
+
+	if (frameCount % 300 == 0) {
+		LogLine(LogLevel::Info) << "Render scale " << (int)std::round(renderScale * 100.0f) << "% (" << smoothedFrameMs << " ms / frame" << (timestampQueryPool != VK_NULL_HANDLE ? " on the GPU" : "")
+			<< ", target " << TARGET_FRAME_TIME_MS << " ms)";
+	}
+}
+
+// Scales the drawn corner of the offscreen target up to the whole swap chain image
+void SuperSphere::recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkExtent2D renderExtent) {
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = swapChainImages[imageIndex];
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	// The acquire semaphore is waited on at the transfer stage, which this chains onto
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkImageBlit blit{};
+	blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.srcSubresource.mipLevel = 0;
+	blit.srcSubresource.baseArrayLayer = 0;
+	blit.srcSubresource.layerCount = 1;
+	blit.srcOffsets[0] = { 0, 0, 0 };
+	blit.srcOffsets[1] = { (int32_t)renderExtent.width, (int32_t)renderExtent.height, 1 };
+	blit.dstSubresource = blit.srcSubresource;
+	blit.dstOffsets[0] = { 0, 0, 0 };
+	blit.dstOffsets[1] = { (int32_t)swapChainExtent.width, (int32_t)swapChainExtent.height, 1 };
+
+	vkCmdBlitImage(commandBuffer, offscreenImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+// One pipeline statistics query per frame in flight; left null where the device can't count fragment shader invocations
+void SuperSphere::createQueryPool() {
+	statisticsQueryPixels.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+	VkPhysicalDeviceFeatures deviceFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
+
+	if (deviceFeatures.pipelineStatisticsQuery != VK_TRUE) {
+		LogLine(LogLevel::Info) << "Pipeline statistics queries unsupported - overdraw mode will not report fragment counts";
+		return;
+	}
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT;
+	queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+	if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &statisticsQueryPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create query pool!");
+	}
+}
+
+// A pair of timestamps per frame in flight around the scene pass, for dynamic resolution
+void SuperSphere::createTimestampQueryPool() {
+	timestampsWritten.assign(MAX_FRAMES_IN_FLIGHT, false);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[queueFamilyIndices.graphicsFamily.value()].timestampValidBits;
+
+	if (validBits == 0) {
+		LogLine(LogLevel::Info) << "Timestamp queries unsupported - dynamic resolution will follow the frame interval";
+		return;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	timestampPeriodNs = properties.limits.timestampPeriod;
+	timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2;
+
+	if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampQueryPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timestamp query pool!");
+	}
+}
+
+// Called after this frame's fence wait, so the query recorded the last time this slot was used has its result
+void SuperSphere::readOverdrawStatistics() {
+	uint64_t pixels = statisticsQueryPixels[currentFrame];
+
+	if (pixels == 0) {
+		return;
+	}
+
+	statisticsQueryPixels[currentFrame] = 0;
+
+	uint64_t fragments = 0;
+
+	if (vkGetQueryPoolResults(device, statisticsQueryPool, currentFrame, 1, sizeof(fragments), &fragments, sizeof(fragments), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return;
+	}
+
+	overdrawFragments += fragments;
+	overdrawPixels += pixels;
+	overdrawFrames++;
+
+	// Averaged over a second's worth of frames or so
+	if (overdrawFrames == 60) {
+		LogLine(LogLevel::Info) << "Overdraw: " << (double)overdrawFragments / (double)overdrawPixels << " shaded fragments per pixel at detail " << detail
+			<< " (depth test " << (DEPTH_BUFFER ? "on" : "off") << ", culling " << (CULLBACK ? "on" : "off") << ")";
+
+		overdrawFragments = 0;
+		overdrawPixels = 0;
+		overdrawFrames = 0;
+	}
+}
+
 void SuperSphere::createCommandPools() {
 	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
@@ -764,15 +1851,6 @@ void SuperSphere::createCommandPools() {
 	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create command pool!");
 	}
-
-	VkCommandPoolCreateInfo transferPoolInfo{};
-	transferPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	transferPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-	transferPoolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-
-	if (vkCreateCommandPool(device, &transferPoolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create transfer command pool!");
-	}
 }
 
 void SuperSphere::createCommandBuffers() {
@@ -799,47 +1877,96 @@ void SuperSphere::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
 		throw std::runtime_error("Failed to begin recording command buffer!");
 	}
 
+	// Counts fragment shader invocations for the overdraw report
+	bool queryStatistics = overdrawMode && statisticsQueryPool != VK_NULL_HANDLE;
+
+	if (queryStatistics) {
+		vkCmdResetQueryPool(commandBuffer, statisticsQueryPool, currentFrame, 1);
+		vkCmdBeginQuery(commandBuffer, statisticsQueryPool, currentFrame, 0);
+	}
+
+	// Brackets the scene pass, for dynamic resolution's GPU time
+	bool queryTimestamps = timestampQueryPool != VK_NULL_HANDLE;
+
+	if (queryTimestamps) {
+		vkCmdResetQueryPool(commandBuffer, timestampQueryPool, currentFrame * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2);
+	}
+
+	VkExtent2D renderExtent = getRenderExtent();
+
+	statisticsQueryPixels[currentFrame] = queryStatistics ? (uint64_t)renderExtent.width * renderExtent.height : 0;
+
 	// Render pass - different from creation
 	VkRenderPassBeginInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = renderPass;
-	renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+	renderPassInfo.framebuffer = DYNAMIC_RESOLUTION ? offscreenFramebuffer : swapChainFramebuffers[imageIndex];
 	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = swapChainExtent;
+	renderPassInfo.renderArea.extent = renderExtent;
+
+	VkClearValue clearValues[2]{};
+	clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
 
-	VkClearValue clearColour = { {{0.0f, 0.0f, 0.0f}} };
-	renderPassInfo.clearValueCount = 1;
-	renderPassInfo.pClearValues = &clearColour;
+	renderPassInfo.clearValueCount = DEPTH_BUFFER ? 2 : 1;
+	renderPassInfo.pClearValues = clearValues;
 
 	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, overdrawMode ? overdrawPipeline : graphicsPipeline);
   
+	const GeometrySlot& geometry = geometrySlots[activeGeometry];
 	VkDeviceSize offsets[] = { 0 };
   
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &unifiedBuffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, unifiedBuffer, sizeof(vertices[0]) * vertices.size(), VK_INDEX_TYPE_UINT16);
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &geometry.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, geometry.buffer, geometry.indexOffset, VK_INDEX_TYPE_UINT32);
 
 	// Viewport and scissor are dynamic, so created here, not with render pipeline
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(swapChainExtent.width);
-	viewport.height = static_cast<float>(swapChainExtent.height);
+	viewport.width = static_cast<float>(renderExtent.width);
+	viewport.height = static_cast<float>(renderExtent.height);
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
 	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
 	VkRect2D scissor{};
 	scissor.offset = { 0, 0 };
-	scissor.extent = swapChainExtent;
+	scissor.extent = renderExtent;
 	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	// Bind the right descriptor set for each frame
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
-	vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	// One descriptor set for every frame - the dynamic offset picks this frame's slot in the uniform ring
+	uint32_t uniformOffset = static_cast<uint32_t>(currentFrame * uniformStride);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &uniformOffset);
+
+	PushConstants pushConstants{};
+	pushConstants.model = modelMatrix;
+	pushConstants.sectors = geometry.sectors;
+	pushConstants.sectorColumns = geometry.sectorColumns;
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+	vkCmdDrawIndexed(commandBuffer, geometry.indexCount, geometry.sectors, 0, 0, 0);
 
 	vkCmdEndRenderPass(commandBuffer);
 
+	if (queryTimestamps) {
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2 + 1);
+		timestampsWritten[currentFrame] = true;
+	}
+
+	if (DYNAMIC_RESOLUTION) {
+		recordUpscale(commandBuffer, imageIndex, renderExtent);
+	}
+
+	if (frameCaptureSlots.size() > 0 && frameCaptureSlots[currentFrame] >= 0) {
+		recordCapture(commandBuffer, imageIndex, captureBuffers[frameCaptureSlots[currentFrame]]);
+	}
+
+	if (queryStatistics) {
+		vkCmdEndQuery(commandBuffer, statisticsQueryPool, currentFrame);
+	}
+
 	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to record command buffer!");
 	}
@@ -869,23 +1996,42 @@ void SuperSphere::createSyncObjects() {
 
 }
 
-void SuperSphere::drawFrame() {
+// False if the frame was dropped because the swap chain had to be recreated first
+bool SuperSphere::drawFrame() {
 	// Must wait for previous frame to finish in order to use command buffer / semaphores
+	auto fenceWaitStart = std::chrono::steady_clock::now();
 	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+	fenceWaitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - fenceWaitStart).count();
+
+	flushDeletionQueue();
+	updateGeometry();
+	readOverdrawStatistics();
+
+	if (CAPTURE) {
+		collectCapture(currentFrame);
+	}
+
+	if (DYNAMIC_RESOLUTION) {
+		updateRenderScale();
+	}
 
 	uint32_t imageIndex;
 	VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		recreateSwapChain();
-		return;
+		return false;
 	}
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
 		throw std::runtime_error("Failed to acquire swap chain iamge!");
 	}
 
-	camera.updateEye();
-	camera.updateCentre();
+	uploader.collect();
+
+	if (CAPTURE && frameCount % CAPTURE_INTERVAL == 0) {
+		reserveCapture();
+	}
+
 	updateUniformBuffer(currentFrame);
 
 	vkResetFences(device, 1, &inFlightFences[currentFrame]); // Only submit if we are actually submitting work
@@ -899,12 +2045,22 @@ void SuperSphere::drawFrame() {
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
-	VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
+	// The geometry may still be in flight on the transfer queue - wait for it on the GPU, not here
+	VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame], uploader.getTimeline() };
+	// With dynamic resolution the swap chain image isn't needed until the upscaling blit
+	VkPipelineStageFlags imageWaitStage = DYNAMIC_RESOLUTION ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkPipelineStageFlags waitStages[] = { imageWaitStage, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT };
+	uint64_t waitValues[] = { 0, geometrySlots[activeGeometry].uploadValue }; // Binary semaphores ignore their value
+	submitInfo.waitSemaphoreCount = 2;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = 2;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	submitInfo.pNext = &timelineInfo;
+
 
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
 	submitInfo.signalSemaphoreCount = 1;
@@ -914,6 +2070,23 @@ void SuperSphere::drawFrame() {
 		throw std::runtime_error("Failed to submit draw command buffer!");
 	}
 
+	submittedFrames++;
+
+	auto submitTime = std::chrono::high_resolution_clock::now();
+
+	// Hitch = the gap between the last frame submitted before the swapchain was recreated and the first one after it
+	if (measuringResizeHitch) {
+		float hitchMs = std::chrono::duration<float, std::milli>(submitTime - lastSubmitTime).count();
+		maxResizeHitchMs = std::max(maxResizeHitchMs, hitchMs);
+		measuringResizeHitch = false;
+
+		LogLine(LogLevel::Info) << "Swapchain recreated in " << swapChainRecreateMs << " ms, frame gap " << hitchMs << " ms (worst " << maxResizeHitchMs << " ms)";
+	}
+
+	lastSubmitTime = submitTime;
+
+	recordInputLatency();
+
 	// We have the rendered image - now, we need to submit it back to the swapchain!
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -937,10 +2110,20 @@ void SuperSphere::drawFrame() {
 		throw std::runtime_error("Failed to present swap chain image!");
 	}
 
-	currentFrame = (currentFrame + 1) & MAX_FRAMES_IN_FLIGHT;
+	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+	return true;
 }
 
 void SuperSphere::cleanupSwapChain() {
+	if (offscreenFramebuffer != VK_NULL_HANDLE) {
+		vkDestroyFramebuffer(device, offscreenFramebuffer, nullptr);
+		offscreenFramebuffer = VK_NULL_HANDLE;
+	}
+
+	destroyImage(offscreenImage, offscreenImageView, offscreenImageAllocation);
+	destroyImage(depthImage, depthImageView, depthImageAllocation);
+
 	for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
 		vkDestroyFramebuffer(device, swapChainFramebuffers[i], nullptr);
 	}
@@ -953,153 +2136,238 @@ void SuperSphere::cleanupSwapChain() {
 }
 
 void SuperSphere::recreateSwapChain() {
-	int width = 0;
-	int height = 0;
+	// Minimised - wait for the event thread to report a size again, or for the window to close
+	while (framebufferSize.width == 0 || framebufferSize.height == 0) {
+		if (!renderRunning.load(std::memory_order_acquire)) {
+			return;
+		}
 
-	glfwGetFramebufferSize(window, &width, &height);
+		renderWake.waitFor(std::chrono::duration<double>(IDLE_WAIT_SECONDS));
 
-	while (width == 0 || height == 0) {
-		glfwGetFramebufferSize(window, &width, &height);
-		glfwWaitEvents();
+		// Only the size - input stays queued for the top of the render loop, not handled mid-frame
+		if (framebufferSizes.update()) {
+			framebufferSize = framebufferSizes.front();
+		}
 	}
 
-	vkDeviceWaitIdle(device);
+	auto recreateStart = std::chrono::high_resolution_clock::now();
 
-	vkDeviceWaitIdle(device); // Don't touch resources that are still in use!
+	// No device idle - frames in flight keep using the old swapchain objects, which are retired once their fences pass
+	VkSwapchainKHR oldSwapChain = swapChain;
+	std::vector<VkImageView> oldImageViews = std::move(swapChainImageViews);
+	std::vector<VkFramebuffer> oldFramebuffers = std::move(swapChainFramebuffers);
 
-	cleanupSwapChain();
+	swapChainImageViews.clear();
+	swapChainFramebuffers.clear();
+
+	VkImage oldDepthImage = depthImage;
+	VkImageView oldDepthImageView = depthImageView;
+	Allocation oldDepthImageAllocation = depthImageAllocation;
+
+	VkImage oldOffscreenImage = offscreenImage;
+	VkImageView oldOffscreenImageView = offscreenImageView;
+	Allocation oldOffscreenImageAllocation = offscreenImageAllocation;
+	VkFramebuffer oldOffscreenFramebuffer = offscreenFramebuffer;
 
 	createSwapChain();
 	createImageViews();
+	createDepthResources();
+	createOffscreenTarget();
 	createFramebuffers();
-}
 
-// Copy buffer using transient operations
-void SuperSphere::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size) {
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = transferCommandPool;
-	allocInfo.commandBufferCount = 1;
+	deferDestroy([this, oldDepthImage, oldDepthImageView, oldDepthImageAllocation, oldOffscreenImage, oldOffscreenImageView, oldOffscreenImageAllocation, oldOffscreenFramebuffer]() mutable {
+		if (oldOffscreenFramebuffer != VK_NULL_HANDLE) {
+			vkDestroyFramebuffer(device, oldOffscreenFramebuffer, nullptr);
+		}
 
-	VkCommandBuffer transferCommandBuffer;
-	vkAllocateCommandBuffers(device, &allocInfo, &transferCommandBuffer);
+		destroyImage(oldOffscreenImage, oldOffscreenImageView, oldOffscreenImageAllocation);
+		destroyImage(oldDepthImage, oldDepthImageView, oldDepthImageAllocation);
+	});
 
-	// Start recording
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	// Fences don't cover presentation itself, but by the time MAX_FRAMES_IN_FLIGHT newer frames have retired, the old
+	// swapchain has long stopped presenting
+	deferDestroy([this, oldSwapChain, oldImageViews, oldFramebuffers]() {
+		for (VkFramebuffer framebuffer : oldFramebuffers) {
+			vkDestroyFramebuffer(device, framebuffer, nullptr);
+		}
 
-	if (vkBeginCommandBuffer(transferCommandBuffer, &beginInfo) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to begin recording transfer buffer!");
-	}
+		for (VkImageView imageView : oldImageViews) {
+			vkDestroyImageView(device, imageView, nullptr);
+		}
 
-	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0;
-	copyRegion.dstOffset = dstOffset;
-	copyRegion.size = size;
+		vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+	});
 
-	vkCmdCopyBuffer(transferCommandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+	updateProjection();
 
-	vkEndCommandBuffer(transferCommandBuffer);
+	swapChainRecreateMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - recreateStart).count();
+	measuringResizeHitch = true;
+}
 
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &transferCommandBuffer;
+void SuperSphere::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MemoryPurpose purpose, VkBuffer& buffer, Allocation& allocation,
+	AllocationLifetime lifetime) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE); // Nothing we need to wait for
-	vkQueueWaitIdle(graphicsQueue); // Could use a fence, but not needed unless scheduling multiple simultaneous transfers
+	// Upload destinations are written by the transfer queue and read by the graphics queue
+	uint32_t sharingFamilies[] = { queueFamilyIndices.graphicsFamily.value(), queueFamilyIndices.transferFamily.value() };
 
-	vkFreeCommandBuffers(device, transferCommandPool, 1, &transferCommandBuffer);
-};
+	if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && sharingFamilies[0] != sharingFamilies[1]) {
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = 2;
+		bufferInfo.pQueueFamilyIndices = sharingFamilies;
+	}
 
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create buffer!");
+	}
 
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-void SuperSphere::createVertexBuffer(VkDeviceMemory& stagingBufferMemory) {
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+	// Sub-allocated from a shared block rather than a vkAllocateMemory per buffer
+	allocation = allocator.allocate(memRequirements, properties, purpose, lifetime);
 
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
+	vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
 }
 
-void SuperSphere::createIndexBuffer(VkDeviceMemory& stagingBufferMemory) {
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+void SuperSphere::destroyBuffer(VkBuffer& buffer, Allocation& allocation) {
+	vkDestroyBuffer(device, buffer, nullptr);
+	allocator.free(allocation);
 
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, sizeof(vertices[0]) * vertices.size(), bufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
+	buffer = VK_NULL_HANDLE;
 }
 
-uint32_t SuperSphere::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-	// Query available types of memory
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+// Uploads the startup mesh into the first geometry slot in one go; the first frame waits for it on the GPU
+void SuperSphere::createGeometry() {
+	beginGeometryUpload(geometrySlots[activeGeometry], std::move(initialMesh));
+	streamGeometry(geometrySlots[activeGeometry], pendingMesh, geometrySlots[activeGeometry].size);
 
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-		// Correct memory types available AND all correct properties satisfied
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-			return i;
-		}
-	}
+	pendingMesh = Mesh{};
+}
+
+// Creates a unified vertex / index buffer for the mesh, and keeps the mesh around until it has been streamed
+void SuperSphere::beginGeometryUpload(GeometrySlot& slot, Mesh&& mesh) {
+	VkDeviceSize vertexBufferSize = sizeof(Vertex) * mesh.vertexCount();
+	VkDeviceSize indexBufferSize = sizeof(mesh.indices[0]) * mesh.indices.size();
+
+	slot.detail = mesh.detail;
+	slot.indexOffset = vertexBufferSize;
+	slot.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	slot.sectors = mesh.sectors;
+	slot.sectorColumns = mesh.sectorColumns;
+	slot.size = vertexBufferSize + indexBufferSize;
+	slot.uploadedBytes = 0;
+
+	createBuffer(slot.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryPurpose::Geometry, slot.buffer, slot.allocation);
 
-	throw std::runtime_error("Failed to find suitable memory type!");
+	pendingMesh = std::move(mesh);
 }
 
-void SuperSphere::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
-	VkBufferCreateInfo bufferInfo{};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = size;
-	bufferInfo.usage = usage;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+// Hands at most budget bytes of the mesh to the uploader, so a big mesh is copied over several frames instead of one
+void SuperSphere::streamGeometry(GeometrySlot& slot, Mesh& mesh, VkDeviceSize budget) {
+	VkDeviceSize end = std::min(slot.size, slot.uploadedBytes + budget);
 
-	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create buffer!");
-	}
+	while (slot.uploadedBytes < end) {
+		if (slot.uploadedBytes < slot.indexOffset) {
+			// Whole vertices, interleaved from the mesh's arrays straight into staging memory
+			size_t first = slot.uploadedBytes / sizeof(Vertex);
+			size_t count = std::min(mesh.vertexCount() - first, (size_t)((std::min(end, slot.indexOffset) - slot.uploadedBytes + sizeof(Vertex) - 1) / sizeof(Vertex)));
+			VkDeviceSize size = count * sizeof(Vertex);
 
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+			interleaveVertices(mesh, first, count, static_cast<Vertex*>(uploader.enqueueWrite(slot.buffer, slot.uploadedBytes, size)));
+			slot.uploadedBytes += size;
+		}
+		else {
+			VkDeviceSize size = end - slot.uploadedBytes;
+			uploader.enqueue(slot.buffer, slot.uploadedBytes, reinterpret_cast<const char*>(mesh.indices.data()) + (slot.uploadedBytes - slot.indexOffset), size);
+			slot.uploadedBytes += size;
+		}
+	}
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+	slot.uploadValue = uploader.flush();
 
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate buffer memory!");
+	if (RELEASE_MESH_AFTER_UPLOAD && slot.uploadedBytes == slot.size) {
+		mesh = Mesh{};
 	}
+}
 
-	vkBindBufferMemory(device, buffer, bufferMemory, 0);
+// Public API - the new mesh is built and uploaded in the background, the current one stays on screen until then
+void SuperSphere::setDetail(size_t newDetail) {
+	requestedDetail = std::clamp(newDetail, MIN_DETAIL, MAX_DETAIL);
+	detailRequestTime = std::chrono::high_resolution_clock::now();
 }
 
-// Creates a unified vertex / index buffer
-void SuperSphere::createUnifiedBuffer() {
-	VkDeviceSize vertexBufferSize = sizeof(vertices[0]) * vertices.size();
-	VkDeviceSize indexBufferSize = sizeof(indices[0]) * indices.size();
-	VkDeviceSize unifiedSize = vertexBufferSize + indexBufferSize;
+// Called once per frame, after this frame's fence wait - never blocks on the worker or the transfer queue
+void SuperSphere::updateGeometry() {
+	GeometrySlot& active = geometrySlots[activeGeometry];
+	GeometrySlot& inactive = geometrySlots[1 - activeGeometry];
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(unifiedSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	if (geometryUploading) {
+		if (inactive.uploadedBytes < inactive.size) {
+			streamGeometry(inactive, pendingMesh, GEOMETRY_UPLOAD_BUDGET);
+			return;
+		}
 
-	// Write data to staging buffer
-	createVertexBuffer(stagingBufferMemory);
-	createIndexBuffer(stagingBufferMemory);
+		if (!uploader.isComplete(inactive.uploadValue)) {
+			return;
+		}
+
+		// Frames already submitted may still be reading the old buffer - it goes once their fences have been waited on
+		VkBuffer buffer = active.buffer;
+		Allocation allocation = active.allocation;
+		deferDestroy([this, buffer, allocation]() mutable { destroyBuffer(buffer, allocation); });
+
+		active = GeometrySlot{};
+		activeGeometry = 1 - activeGeometry;
+		detail = inactive.detail;
+
+		geometryUploading = false;
+		pendingMesh = Mesh{};
+
+		float switchTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - detailRequestTime).count();
+		LogLine(LogLevel::Info) << "Detail " << detail << " live " << switchTime << " ms after request (" << inactive.indexCount / 3 * inactive.sectors << " triangles)";
+
+		return;
+	}
+
+	if (meshJob.valid() && meshJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		Mesh mesh = meshJob.get();
+
+		// Requests made while the worker was busy supersede its result
+		if (mesh.detail == requestedDetail && mesh.detail != detail) {
+			beginGeometryUpload(inactive, std::move(mesh));
+			streamGeometry(inactive, pendingMesh, GEOMETRY_UPLOAD_BUDGET);
+			geometryUploading = true;
+			return;
+		}
+	}
+
+	if (!meshJob.valid() && requestedDetail != detail) {
+		meshJob = std::async(std::launch::async, generateMesh, requestedDetail, radius, sectorCount(requestedDetail, GEOMETRY_SECTORS));
+	}
+}
 
-	createBuffer(unifiedSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, unifiedBuffer, unifiedBufferMemory);
-	copyBuffer(stagingBuffer, unifiedBuffer, 0, unifiedSize);
+void SuperSphere::deferDestroy(std::function<void()> destroy) {
+	deletionQueue.push_back({ submittedFrames, std::move(destroy) });
+}
 
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+// Frame n reuses the fence of frame n - MAX_FRAMES_IN_FLIGHT, so once that fence has been waited on, anything retired
+// before frame n - MAX_FRAMES_IN_FLIGHT was submitted is no longer in use
+void SuperSphere::flushDeletionQueue(bool everything) {
+	while (!deletionQueue.empty() && (everything || deletionQueue.front().first + MAX_FRAMES_IN_FLIGHT <= submittedFrames)) {
+		deletionQueue.front().second();
+		deletionQueue.pop_front();
+	}
 }
 
 void SuperSphere::createDescriptorSetLayout() {
 	VkDescriptorSetLayoutBinding uboLayoutBinding{};
 	uboLayoutBinding.binding = 0;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboLayoutBinding.descriptorCount = 1;
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	uboLayoutBinding.pImmutableSamplers = nullptr; // Only relevant for image-sampling-related descriptors
@@ -1115,54 +2383,124 @@ void SuperSphere::createDescriptorSetLayout() {
 }
 
 void SuperSphere::createUniformBuffers() {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
 
-	uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-	uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-	uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	// Dynamic offsets must be multiples of minUniformBufferOffsetAlignment
+	VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+	uniformStride = (sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment;
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+	createBuffer(uniformStride * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryPurpose::Uniforms, uniformRing, uniformRingAllocation);
 
-		vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
-	}
-}
+	// Every slot starts out stale
+	slotViewVersions.assign(MAX_FRAMES_IN_FLIGHT, UINT64_MAX);
+	slotProjVersions.assign(MAX_FRAMES_IN_FLIGHT, UINT64_MAX);
 
-// New transformation every frame to make the geometry spin around
-void SuperSphere::updateUniformBuffer(uint32_t currentImage) {
-	static auto startTime = std::chrono::high_resolution_clock::now();
-	auto currentTime = std::chrono::high_resolution_clock::now();
+	// The model matrix never changes, and is pushed per draw
+	modelMatrix = glm::rotate(glm::mat4(1.0f), 1.0f * glm::pi<float>() / 2.0f, glm::vec3(0.0f, 0.0f, 1.0f));
 
-	float time = std::chrono::duration<float>(currentTime - startTime).count();
+	viewMatrix = glm::lookAt(camera.eye, camera.centre, camera.up);
+	updateProjection();
+}
 
+// Only needed when the aspect ratio changes
+void SuperSphere::updateProjection() {
 	constexpr float verticalFOV = glm::pi<float>() / 4.0f;
 
-	UniformBufferObject ubo{};
-	ubo.model = glm::rotate(glm::mat4(1.0f), 1.0f * glm::pi<float>() / 2.0f, glm::vec3(0.0f, 0.0f, 1.0f));
-	//ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.view = glm::lookAt(camera.eye, camera.centre, camera.up);
-	ubo.proj = glm::perspective(verticalFOV, swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 100.0f);
-	
-	auto timeSinceEpoch = currentTime.time_since_epoch();
-	
-	ubo.time = time;
+	projMatrix = glm::perspective(verticalFOV, swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 100.0f);
 
 	// GLM originally designed for OpenGL, where Y-coord inverted; we must flip!
-	ubo.proj[1][1] *= -1;
+	projMatrix[1][1] *= -1;
 
-	memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+	projVersion++;
+}
+
+// Writes only what changed since this frame's slot was last used - the time always, the matrices rarely
+void SuperSphere::updateUniformBuffer(uint32_t currentImage) {
+	// As late as possible - after the fence wait and image acquire, right before the view matrix is needed
+	auto currentTime = frameClock();
+	latchInput(currentTime);
+
+	if (controlPlane.isRunning()) {
+		controlPlane.update();
+		applyControlCamera();
+	}
+
+	// Animation time only moves while unpaused; long gaps (idling, dragging the window) are clamped rather than skipped over
+	float frameSeconds = std::chrono::duration<float>(currentTime - lastAnimationTime).count();
+	lastAnimationTime = currentTime;
+
+	if (!animationPaused) {
+		animationTime += std::min(frameSeconds, 0.1f);
+	}
+
+	float time = animationTime;
+
+	glm::mat4 view = glm::lookAt(camera.eye, camera.centre, camera.up);
+
+	if (view != viewMatrix) {
+		viewMatrix = view;
+		viewVersion++;
+	}
+
+	char* slot = static_cast<char*>(uniformRingAllocation.mapped) + currentImage * uniformStride;
+
+	if (slotViewVersions[currentImage] != viewVersion) {
+		memcpy(slot + offsetof(UniformBufferObject, view), &viewMatrix, sizeof(viewMatrix));
+		slotViewVersions[currentImage] = viewVersion;
+	}
+
+	if (slotProjVersions[currentImage] != projVersion) {
+		memcpy(slot + offsetof(UniformBufferObject, proj), &projMatrix, sizeof(projMatrix));
+		slotProjVersions[currentImage] = projVersion;
+	}
+
+	// m sweeps back and forth over 0 -> 7 lobes; the rest of the shape stays at its defaults
+	SupershapeParams shape{};
+	shape.m = map(sin(time), -1.0f, 1.0f, 0.0f, 7.0f);
+
+	if (controlPlane.isRunning()) {
+		applyControlShape(controlPlane.state(), shape);
+	}
+
+	memcpy(slot + offsetof(UniformBufferObject, time), &time, sizeof(time));
+	memcpy(slot + offsetof(UniformBufferObject, shape), &shape, sizeof(shape));
+
+	currentShape = shape;
+}
+
+// A camera sent through the control plane replaces the current one once; keys and the mouse carry on from there
+void SuperSphere::applyControlCamera() {
+	const ControlState& control = controlPlane.state();
+
+	if (control.eyeVersion == controlEyeVersion && control.lookVersion == controlLookVersion) {
+		return;
+	}
+
+	if (control.eyeVersion != controlEyeVersion) {
+		camera.eye = control.eye;
+		controlEyeVersion = control.eyeVersion;
+	}
+
+	if (control.lookVersion != controlLookVersion) {
+		camera.theta = control.theta;
+		camera.phi = control.phi;
+		controlLookVersion = control.lookVersion;
+	}
+
+	camera.updateCentre();
 }
 
 void SuperSphere::createDescriptorPool() {
 	VkDescriptorPoolSize poolSize{};
-	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSize.descriptorCount = 1;
 
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = 1;
 	poolInfo.pPoolSizes = &poolSize;
-	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolInfo.maxSets = 1;
 
 	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create descriptor pool!");
@@ -1170,38 +2508,32 @@ void SuperSphere::createDescriptorPool() {
 }
 
 void SuperSphere::createDescriptorSets() {
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
-
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = descriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	allocInfo.pSetLayouts = layouts.data();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &descriptorSetLayout;
 
-	descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-
-	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+	if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to allocate descriptor sets!");
 	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		// Our descriptors refer to buffers, so we use VkDescriptorBufferInfo
-		VkDescriptorBufferInfo bufferInfo{};
-		bufferInfo.buffer = uniformBuffers[i];
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
+	// Describes a single slot; the dynamic offset given at bind time moves it along the ring
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = uniformRing;
+	bufferInfo.offset = 0;
+	bufferInfo.range = sizeof(UniformBufferObject);
 
-		VkWriteDescriptorSet descriptorWrite{};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = descriptorSets[i];
-		descriptorWrite.dstBinding = 0;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite.descriptorCount = 1;
-		descriptorWrite.pBufferInfo = &bufferInfo;
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = descriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pBufferInfo = &bufferInfo;
 
-		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
-	}
+	vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
 }
 
 void SuperSphere::createCamera() {
@@ -1221,83 +2553,718 @@ void SuperSphere::createCamera() {
 	cameraCursorPosCallback = &cursorPosCallback;
 
 	camera.initControls(window, keyCallback, cameraCursorPosCallback);
+
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
 }
 
-float map(float value, float a1, float b1, float a2, float b2) {
-	if (a1 > value) {
-		throw std::runtime_error("Value cannot be outside first range!");
+// Event thread. Never blocks: a full queue drops the event
+void SuperSphere::postWindowEvent(const WindowEvent& event) {
+	if (!windowEvents.push(event)) {
+		droppedWindowEvents.fetch_add(1, std::memory_order_relaxed);
 	}
-	else if (b1 < a1 || b2 < a2) {
-		throw std::runtime_error("Second element of range must be greater than first!");
+
+	renderWake.notify();
+
+	// From the callback being entered, which is when event.time was taken
+	int64_t handlingNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - event.time).count();
+	int64_t previousMax = eventHandlingMaxNs.load(std::memory_order_relaxed);
+
+	eventCount.fetch_add(1, std::memory_order_relaxed);
+	eventHandlingNs.fetch_add(handlingNs, std::memory_order_relaxed);
+
+	while (handlingNs > previousMax && !eventHandlingMaxNs.compare_exchange_weak(previousMax, handlingNs, std::memory_order_relaxed)) {}
+}
+
+// Render thread, before anything else in a frame
+void SuperSphere::takeWindowEvents() {
+	auto now = std::chrono::steady_clock::now();
+	WindowEvent event;
+
+	while (windowEvents.pop(event)) {
+		float waitUs = std::chrono::duration<float, std::micro>(now - event.time).count();
+
+		handoffUsSum += waitUs;
+		handoffUsMax = std::max(handoffUsMax, waitUs);
+		handoffCount++;
+
+		applyWindowEvent(event);
 	}
 
-	float range1 = b1 - a1;
-	float range2 = b2 - a2;
+	if (framebufferSizes.update()) {
+		framebufferSize = framebufferSizes.front();
+		framebufferResized = true;
+	}
+}
+
+void SuperSphere::applyWindowEvent(const WindowEvent& event) {
+	if (event.type == WindowEventType::Refresh) {
+		redrawRequested = true;
+		return;
+	}
+
+	if (inputReplay.isReplaying()) {
+		return;
+	}
+
+	switch (event.type) {
+	case WindowEventType::Key:
+		inputRecorder.add(ReplayRecordType::Key, (uint32_t)frameCount, event.time, event.code, event.action);
+		handleKey(event.code, event.action, event.time);
+		break;
+
+	case WindowEventType::Cursor:
+		inputRecorder.add(ReplayRecordType::Cursor, (uint32_t)frameCount, event.time, 0, 0, event.x, event.y);
+		handleCursor(event.x, event.y, event.time);
+		break;
 
-	return a2 + (value - a1) * range2 / range1;
+	case WindowEventType::MouseButton:
+		inputRecorder.add(ReplayRecordType::MouseButton, (uint32_t)frameCount, event.time, event.code, event.action);
+		handleMouseButton(event.code, event.action);
+		break;
+
+	default:
+		break;
+	}
 }
 
-glm::vec3 colours[] = {
-	{1.0f, 0.0f, 0.0f}, // RED
-	{1.0f, 0.5f, 0.0f}, // ORANGE
-	{1.0f, 1.0f, 0.0f}, // YELLOW
-	{0.0f, 1.0f, 0.0f}, // GREEN
-	{0.0f, 0.0f, 1.0f}, // BLUE
-	{0.58f, 0.0f, 0.83f} // VIOLET
-};
+// Both threads over the last wallSeconds: the event thread's callbacks, and the render thread's busy time per frame
+void SuperSphere::reportThreadTiming(float wallSeconds) {
+	uint64_t events = eventCount.exchange(0, std::memory_order_relaxed);
+	int64_t handlingNs = eventHandlingNs.exchange(0, std::memory_order_relaxed);
+	int64_t handlingMaxNs = eventHandlingMaxNs.exchange(0, std::memory_order_relaxed);
+	uint64_t dropped = droppedWindowEvents.exchange(0, std::memory_order_relaxed);
+
+	{
+		LogLine report(LogLevel::Info);
+		report << "Event thread: " << events << " events (" << (wallSeconds > 0.0f ? events / wallSeconds : 0.0f) << "/s), handled in "
+			<< (events > 0 ? handlingNs / 1000.0 / events : 0.0) << " us average, " << handlingMaxNs / 1000.0 << " us worst, taken by the render thread after "
+			<< (handoffCount > 0 ? handoffUsSum / handoffCount : 0.0) << " us average, " << handoffUsMax << " us worst";
+
+		if (dropped > 0) {
+			report << " (" << dropped << " dropped)";
+		}
+	}
 
-uint16_t SuperSphere::IX(int i, int j) {
-	return i * 2 * detail + j;
+	LogLine(LogLevel::Info) << "Render thread: " << renderFrameCount << " frames, " << (renderFrameCount > 0 ? renderFrameMsSum / renderFrameCount : 0.0)
+		<< " ms average, " << renderFrameMsMax << " ms worst";
+
+	renderFrameMsSum = 0.0;
+	renderFrameMsMax = 0.0f;
+	renderFrameCount = 0;
+	handoffUsSum = 0.0;
+	handoffUsMax = 0.0f;
+	handoffCount = 0;
 }
 
-// Initial conditions
-void SuperSphere::createVertices() {
-	for (size_t i = 0; i < detail + 1; i++) {
-		float phi = map((float)i, 0.0f, (float)detail, -0.5f * glm::pi<float>(), 0.5f * glm::pi<float>());
-		for (size_t j = 0; j < 2 * detail; j++) {
-			float theta = map((float)j, 0.0f, 2.0f * (float)detail, -glm::pi<float>(), glm::pi<float>());
+// Called from the input handlers
+void SuperSphere::queueInput(const InputEvent& event) {
+	if (!inputQueue.push(event)) {
+		droppedInputEvents++;
+	}
+}
 
-			float x = radius * cos(theta) * cos(phi);
-			float y = radius * sin(theta) * cos(phi);
-			float z = radius * sin(phi);
+// Applies queued input in the order it happened: movement is integrated over the real time each set of keys was held
+void SuperSphere::latchInput(std::chrono::steady_clock::time_point now) {
+	latchedEventTimes.clear();
 
-			Vertex vertex{};
-			vertex.pos = glm::vec3(x, y, z);
-			vertex.colour = colours[((int)round(i) / 2) % (sizeof(colours) / sizeof(glm::vec3))];
-			//vertex.colour = glm::vec3(1.0f, 1.0f, 1.0f);
+	InputEvent event;
 
-			vertices.push_back(vertex);
+	while (inputQueue.pop(event)) {
+		advanceCamera(event.time);
+		applyInputEvent(event);
+
+		// Replayed events carry recorded times, so their latency would mean nothing
+		if (!inputReplay.isReplaying()) {
+			latchedEventTimes.push_back(event.time);
 		}
 	}
 
-	for (uint16_t i = 0; i < detail + 1; i++) {
-		std::cout << vertices[IX(i, 0)].pos.z << std::endl;
+	advanceCamera(now);
+	camera.updateCentre();
+}
+
+void SuperSphere::advanceCamera(std::chrono::steady_clock::time_point time) {
+	if (time <= lastCameraTime) {
+		return;
+	}
+
+	// Long gaps (a stalled or dragged window) are clamped, so the camera doesn't lurch when frames resume
+	float dt = std::chrono::duration<float>(time - lastCameraTime).count();
+	camera.updateEye(std::min(dt, 0.1f));
+
+	lastCameraTime = time;
+}
+
+void SuperSphere::applyInputEvent(const InputEvent& event) {
+	if (event.type == InputEventType::CursorMove) {
+		camera.theta -= event.dx * camera.sensitivity;
+		camera.phi += event.dy * camera.sensitivity;
+
+		// Later movement in this batch heads the new way
+		camera.updateCentre();
+		return;
+	}
+
+	bool pressed = event.action == GLFW_PRESS;
+
+	switch (event.key) {
+	case GLFW_KEY_W:
+		camera.controls.forwards = pressed;
+		break;
+
+	case GLFW_KEY_S:
+		camera.controls.backwards = pressed;
+		break;
+
+	case GLFW_KEY_A:
+		camera.controls.left = pressed;
+		break;
+
+	case GLFW_KEY_D:
+		camera.controls.right = pressed;
+		break;
+
+	case GLFW_KEY_LEFT_SHIFT:
+		camera.controls.down = pressed;
+		break;
+
+	case GLFW_KEY_SPACE:
+		camera.controls.up = pressed;
+		break;
 	}
 }
 
-// Initial conditions
-void SuperSphere::createIndices() {
-	glm::vec3 pos = vertices[vertices.size() - 1].pos;
-	
-	std::cout << pos.x << " " << pos.y << " " << pos.z << std::endl;
+// Event timestamp to vkQueueSubmit, for every event that made it into the frame just submitted
+void SuperSphere::recordInputLatency() {
+	auto now = std::chrono::steady_clock::now();
+
+	for (auto time : latchedEventTimes) {
+		float latencyMs = std::chrono::duration<float, std::milli>(now - time).count();
+
+		inputLatencySumMs += latencyMs;
+		inputLatencyMaxMs = std::max(inputLatencyMaxMs, latencyMs);
+		inputLatencyCount++;
+	}
+
+	latchedEventTimes.clear();
+
+	if (inputLatencyCount > 0 && now - lastInputLatencyReport > std::chrono::seconds(5)) {
+		LogLine report(LogLevel::Info);
+		report << "Input to submit: " << inputLatencySumMs / inputLatencyCount << " ms average, " << inputLatencyMaxMs << " ms worst over "
+			<< inputLatencyCount << " events";
+
+		if (droppedInputEvents > 0) {
+			report << " (" << droppedInputEvents << " dropped)";
+		}
+
+		inputLatencySumMs = 0.0;
+		inputLatencyMaxMs = 0.0f;
+		inputLatencyCount = 0;
+		lastInputLatencyReport = now;
+	}
+}
+
+// Measured on the grid currently drawn - pause the animation first for a shape that stays put
+void SuperSphere::printShapeMetrics() {
+	ShapeMetrics metrics = measureSupershape(currentShape, detail);
+
+	LogLine(LogLevel::Info) << "Shape m=" << currentShape.m << " n1=" << currentShape.n1 << " n2=" << currentShape.n2 << " n3=" << currentShape.n3
+		<< " at detail " << detail << ": area " << metrics.area << ", volume " << metrics.volume << ", bounds (" << metrics.boundsMin.x << ", "
+		<< metrics.boundsMin.y << ", " << metrics.boundsMin.z << ") -> (" << metrics.boundsMax.x << ", " << metrics.boundsMax.y << ", "
+		<< metrics.boundsMax.z << ") in " << metrics.milliseconds << " ms";
+}
 
-	for (size_t i = 0; i < detail; i++) {
-		for (size_t j = 0; j < 2 * detail; j++) {
-			uint16_t bottomLeft = IX(i, j);
-			uint16_t bottomRight = IX(i, (j + 1) % (2 * detail));
-			uint16_t topLeft = IX(i + 1, j);
-			uint16_t topRight = IX(i + 1, (j + 1) % (2 * detail));
+// Along the view direction - the cursor is captured, so the centre of the screen is what the camera looks at
+// Picks against the last tree finished, which may lag the animated shape by a refit - and starts that refit if none is
+// running, so clicks while the shape animates never stall a frame or pile work up
+void SuperSphere::pickSurface() {
+	// The BVH is in model space; the model matrix only rotates, so a direction needn't be renormalised
+	glm::mat4 toModel = glm::inverse(modelMatrix);
+	glm::vec4 origin = toModel * glm::vec4(camera.eye, 1.0f);
+	glm::vec4 direction = toModel * glm::vec4(camera.direction, 0.0f);
 
-			uint16_t triangleIndices[] = {
-				// Triangle #1
-				bottomLeft, bottomRight, topLeft,
-				// Triangle #2
-				bottomRight, topRight, topLeft
-			};
+	pickOrigin = glm::vec3(origin.x, origin.y, origin.z);
+	pickDirection = glm::vec3(direction.x, direction.y, direction.z);
 
-			for (uint16_t index : triangleIndices) {
-				indices.push_back(index);
+	updatePicking();
+
+	bool stale = !pickingBvh || pickingBvh->getDetail() != detail || memcmp(&pickingBvh->getShape(), &currentShape, sizeof(SupershapeParams)) != 0;
+
+	if (stale && !pickingJob.valid()) {
+		std::unique_ptr<SurfaceBvh> tree = pickingSpare ? std::move(pickingSpare) : std::make_unique<SurfaceBvh>();
+		SupershapeParams shape = currentShape;
+		size_t treeDetail = detail;
+		uint32_t sectors = geometrySlots[activeGeometry].sectors;
+
+		pickingJobStart = std::chrono::high_resolution_clock::now();
+		pickingJob = std::async(std::launch::async, [this, tree = std::move(tree), shape, treeDetail, sectors]() mutable {
+			if (tree->getDetail() == treeDetail) {
+				tree->update(shape);
 			}
+			else {
+				tree->build(shape, treeDetail, SHADER_PRECISION, radius, sectors);
+			}
+
+			// A pick may be waiting for it - if this lands before the result does, the next idle timeout picks it up
+			renderWake.notify();
+
+			return std::move(tree);
+		});
+	}
+
+	if (!pickingBvh) {
+		LogLine(LogLevel::Info) << "Pick: building the BVH, the hit follows once it is ready";
+		pickPending = true;
+		return;
+	}
+
+	auto pickStart = std::chrono::high_resolution_clock::now();
+	PickHit hit = pickingBvh->intersect(pickOrigin, pickDirection);
+	float pickUs = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - pickStart).count();
+
+	reportPick(hit, pickUs);
+}
+
+// Render thread, every iteration: takes a finished tree and answers a pick that was waiting for one
+void SuperSphere::updatePicking() {
+	if (!pickingJob.valid() || pickingJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		return;
+	}
+
+	pickingSpare = std::move(pickingBvh);
+	pickingBvh = pickingJob.get();
+
+	float buildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - pickingJobStart).count();
+	LogLine(LogLevel::Info) << "Pick: BVH of " << pickingBvh->getNodeCount() << " nodes ready in " << buildMs << " ms";
+
+	if (pickPending) {
+		pickPending = false;
+
+		auto pickStart = std::chrono::high_resolution_clock::now();
+		PickHit hit = pickingBvh->intersect(pickOrigin, pickDirection);
+		float pickUs = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - pickStart).count();
+
+		reportPick(hit, pickUs);
+	}
+}
+
+void SuperSphere::reportPick(const PickHit& hit, float pickUs) {
+	bool current = memcmp(&pickingBvh->getShape(), &currentShape, sizeof(SupershapeParams)) == 0 && pickingBvh->getDetail() == detail;
+	const char* age = current ? "" : ", against the last tree finished";
+
+	if (!hit.hit) {
+		LogLine(LogLevel::Info) << "Pick: missed (" << pickUs << " us" << age << ")";
+		return;
+	}
+
+	const SupershapeParams& shape = pickingBvh->getShape();
+
+	LogLine(LogLevel::Info) << "Pick: (" << hit.position.x << ", " << hit.position.y << ", " << hit.position.z << ") at distance " << hit.distance
+		<< ", theta " << hit.theta << " phi " << hit.phi << ", r1 " << supershapeRadius(hit.theta, shape) << " r2 "
+		<< supershapeRadius(hit.phi, shape) << " (" << pickUs << " us" << age << ")";
+}
+
+// The swap chain format is reused for the batch colour target, so batch jobs can share the interactive pipelines
+void SuperSphere::createBatchResources() {
+	if (!readbackFormatSupported()) {
+		throw std::runtime_error("Batch mode needs an 8-bit RGBA or BGRA swap chain format!");
+	}
+
+	batchRenderPass = buildRenderPass(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	batchSlots.resize(MAX_FRAMES_IN_FLIGHT);
+
+	readbackMemoryProperties = findReadbackMemoryProperties();
+}
+
+// Readback (batch mode and capture) hands the raw bytes to the image writers, which only know 4-byte RGBA and BGRA
+bool SuperSphere::readbackFormatSupported() {
+	return swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB || swapChainImageFormat == VK_FORMAT_B8G8R8A8_UNORM ||
+		swapChainImageFormat == VK_FORMAT_R8G8B8A8_SRGB || swapChainImageFormat == VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+bool SuperSphere::readbackIsBgra() {
+	return swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB || swapChainImageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+}
+
+// Cached memory makes the CPU's reads of readback buffers far faster, where the device offers it
+VkMemoryPropertyFlags SuperSphere::findReadbackMemoryProperties() {
+	VkMemoryPropertyFlags cachedProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	const VkPhysicalDeviceMemoryProperties& memProperties = allocator.getMemoryProperties();
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((memProperties.memoryTypes[i].propertyFlags & cachedProperties) == cachedProperties) {
+			return cachedProperties;
+		}
+	}
+
+	return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+void SuperSphere::destroyBatchResources() {
+	for (BatchSlot& slot : batchSlots) {
+		if (slot.readbackBuffer != VK_NULL_HANDLE) {
+			destroyBuffer(slot.readbackBuffer, slot.readbackAllocation);
+		}
+	}
+
+	if (batchFramebuffer != VK_NULL_HANDLE) {
+		vkDestroyFramebuffer(device, batchFramebuffer, nullptr);
+	}
+
+	destroyImage(batchColourImage, batchColourImageView, batchColourImageAllocation);
+	destroyImage(batchDepthImage, batchDepthImageView, batchDepthImageAllocation);
+
+	vkDestroyRenderPass(device, batchRenderPass, nullptr);
+}
+
+// Targets only ever grow, and smaller jobs render into their top-left corner, so mixed sizes don't reallocate per job
+void SuperSphere::ensureBatchTargets(uint32_t width, uint32_t height) {
+	if (batchColourImage != VK_NULL_HANDLE && width <= batchTargetExtent.width && height <= batchTargetExtent.height) {
+		return;
+	}
+
+	batchTargetExtent.width = std::max(batchTargetExtent.width, width);
+	batchTargetExtent.height = std::max(batchTargetExtent.height, height);
+
+	// The job in the other slot may still be rendering into the old targets
+	VkImage oldColourImage = batchColourImage;
+	VkImageView oldColourImageView = batchColourImageView;
+	Allocation oldColourImageAllocation = batchColourImageAllocation;
+	VkImage oldDepthImage = batchDepthImage;
+	VkImageView oldDepthImageView = batchDepthImageView;
+	Allocation oldDepthImageAllocation = batchDepthImageAllocation;
+	VkFramebuffer oldFramebuffer = batchFramebuffer;
+
+	deferDestroy([this, oldColourImage, oldColourImageView, oldColourImageAllocation, oldDepthImage, oldDepthImageView, oldDepthImageAllocation, oldFramebuffer]() mutable {
+		if (oldFramebuffer != VK_NULL_HANDLE) {
+			vkDestroyFramebuffer(device, oldFramebuffer, nullptr);
+		}
+
+		destroyImage(oldColourImage, oldColourImageView, oldColourImageAllocation);
+		destroyImage(oldDepthImage, oldDepthImageView, oldDepthImageAllocation);
+	});
+
+	createImage(batchTargetExtent.width, batchTargetExtent.height, swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, MemoryPurpose::Attachments, batchColourImage, batchColourImageAllocation);
+	batchColourImageView = createImageView(batchColourImage, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	if (DEPTH_BUFFER) {
+		createImage(batchTargetExtent.width, batchTargetExtent.height, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, MemoryPurpose::Attachments, batchDepthImage, batchDepthImageAllocation);
+		batchDepthImageView = createImageView(batchDepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+	}
+
+	VkImageView attachments[] = {
+		batchColourImageView,
+		batchDepthImageView
+	};
+
+	VkFramebufferCreateInfo framebufferInfo{};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = batchRenderPass;
+	framebufferInfo.attachmentCount = DEPTH_BUFFER ? 2 : 1;
+	framebufferInfo.pAttachments = attachments;
+	framebufferInfo.width = batchTargetExtent.width;
+	framebufferInfo.height = batchTargetExtent.height;
+	framebufferInfo.layers = 1;
+
+	if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &batchFramebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create framebuffer!");
+	}
+}
+
+// Each job takes the next frame-in-flight slot; the slot's previous job is written out once its fence has passed, while
+// the GPU carries on with the jobs submitted since
+void SuperSphere::renderBatchJob(const BatchJob& job) {
+	BatchSlot& slot = batchSlots[currentFrame];
+
+	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+
+	finishBatchJob(slot);
+	flushDeletionQueue();
+	uploader.collect();
+
+	ensureBatchTargets(job.width, job.height);
+
+	VkDeviceSize readbackSize = (VkDeviceSize)job.width * job.height * 4;
+
+	if (slot.readbackSize < readbackSize) {
+		if (slot.readbackBuffer != VK_NULL_HANDLE) {
+			destroyBuffer(slot.readbackBuffer, slot.readbackAllocation);
 		}
+
+		createBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackMemoryProperties, MemoryPurpose::Readback, slot.readbackBuffer, slot.readbackAllocation);
+		slot.readbackSize = readbackSize;
 	}
+
+	// Fixed camera; only the projection's aspect ratio follows the job
+	UniformBufferObject ubo{};
+	ubo.view = glm::lookAt(camera.eye, camera.centre, camera.up);
+	ubo.proj = glm::perspective(glm::pi<float>() / 4.0f, job.width / (float)job.height, 0.1f, 100.0f);
+	ubo.proj[1][1] *= -1;
+	ubo.time = 0.0f;
+	ubo.shape = job.shape;
+
+	memcpy(static_cast<char*>(uniformRingAllocation.mapped) + currentFrame * uniformStride, &ubo, sizeof(ubo));
+	slotViewVersions[currentFrame] = UINT64_MAX;
+	slotProjVersions[currentFrame] = UINT64_MAX;
+
+	vkResetFences(device, 1, &inFlightFences[currentFrame]);
+	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+	recordBatchCommandBuffer(commandBuffers[currentFrame], job, slot);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+	// No swap chain involved - the geometry upload is the only thing to wait for
+	VkSemaphore waitSemaphore = uploader.getTimeline();
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+	uint64_t waitValue = geometrySlots[activeGeometry].uploadValue;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = 1;
+	timelineInfo.pWaitSemaphoreValues = &waitValue;
+
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.pWaitSemaphores = &waitSemaphore;
+	submitInfo.pWaitDstStageMask = &waitStage;
+
+	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit batch command buffer!");
+	}
+
+	submittedFrames++;
+
+	slot.job = job;
+	slot.pending = true;
+
+	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+void SuperSphere::recordBatchCommandBuffer(VkCommandBuffer commandBuffer, const BatchJob& job, const BatchSlot& slot) {
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording command buffer!");
+	}
+
+	VkExtent2D extent = { job.width, job.height };
+
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = batchRenderPass;
+	renderPassInfo.framebuffer = batchFramebuffer;
+	renderPassInfo.renderArea.offset = { 0, 0 };
+	renderPassInfo.renderArea.extent = extent;
+
+	VkClearValue clearValues[2]{};
+	clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	renderPassInfo.clearValueCount = DEPTH_BUFFER ? 2 : 1;
+	renderPassInfo.pClearValues = clearValues;
+
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+	const GeometrySlot& geometry = geometrySlots[activeGeometry];
+	VkDeviceSize offsets[] = { 0 };
+
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &geometry.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, geometry.buffer, geometry.indexOffset, VK_INDEX_TYPE_UINT32);
+
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = extent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	uint32_t uniformOffset = static_cast<uint32_t>(currentFrame * uniformStride);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &uniformOffset);
+
+	PushConstants pushConstants{};
+	pushConstants.model = modelMatrix;
+	pushConstants.sectors = geometry.sectors;
+	pushConstants.sectorColumns = geometry.sectorColumns;
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+	vkCmdDrawIndexed(commandBuffer, geometry.indexCount, geometry.sectors, 0, 0, 0);
+
+	vkCmdEndRenderPass(commandBuffer);
+
+	// The render pass leaves the target in TRANSFER_SRC_OPTIMAL, with its writes made visible to transfers
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // Tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, batchColourImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.readbackBuffer, 1, &region);
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = slot.readbackBuffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record command buffer!");
+	}
+}
+
+// Only called once the slot's fence has passed
+void SuperSphere::finishBatchJob(BatchSlot& slot) {
+	if (!slot.pending) {
+		return;
+	}
+
+	slot.pending = false;
+
+	toRgb(static_cast<const uint8_t*>(slot.readbackAllocation.mapped), slot.job.width, slot.job.height, readbackIsBgra(), batchRgb);
+
+	// Names come from the job stream, so they mustn't be able to write outside the output directory
+	std::string name = slot.job.name;
+	std::replace_if(name.begin(), name.end(), [](char c) { return c == '/' || c == '\\' || c == ':'; }, '_');
+
+	std::filesystem::path path = batchOutputDirectory / (name + ".png");
+
+	if (!writePng(path.string(), slot.job.width, slot.job.height, batchRgb.data())) {
+		LogLine(LogLevel::Warning) << "Failed to write " << path.string() << "!";
+	}
+}
+
+// Buffers are created on first use, at the size of the frame they capture
+void SuperSphere::createCaptureResources() {
+	if (!readbackFormatSupported()) {
+		throw std::runtime_error("Frame capture needs an 8-bit RGBA or BGRA swap chain format!");
+	}
+
+	readbackMemoryProperties = findReadbackMemoryProperties();
+
+	captureBuffers.resize(CAPTURE_SLOTS);
+	frameCaptureSlots.assign(MAX_FRAMES_IN_FLIGHT, -1);
+
+	// Leave a core or two for the render loop
+	uint32_t encoderThreads = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+
+	frameCapture.start(CAPTURE_DIRECTORY, CAPTURE_FORMAT, CAPTURE_SLOTS, encoderThreads, std::max(1u, 60 / CAPTURE_INTERVAL));
+
+	LogLine(LogLevel::Info) << "Capturing every " << CAPTURE_INTERVAL << " frame(s) to " << CAPTURE_DIRECTORY << " with " << encoderThreads << " encoder thread(s)";
+}
+
+// Called once the swap chain image is acquired, so its extent is final for this frame
+void SuperSphere::reserveCapture() {
+	int slot = frameCapture.acquireSlot(CAPTURE_BLOCK);
+
+	if (slot < 0) {
+		return;
+	}
+
+	// A free slot is idle on both the GPU and the encoders, so its buffer can be replaced right away
+	CaptureBuffer& captureBuffer = captureBuffers[slot];
+	VkDeviceSize size = (VkDeviceSize)swapChainExtent.width * swapChainExtent.height * 4;
+
+	if (captureBuffer.size < size) {
+		if (captureBuffer.buffer != VK_NULL_HANDLE) {
+			destroyBuffer(captureBuffer.buffer, captureBuffer.allocation);
+		}
+
+		createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackMemoryProperties, MemoryPurpose::Readback, captureBuffer.buffer, captureBuffer.allocation);
+		captureBuffer.size = size;
+	}
+
+	captureBuffer.width = swapChainExtent.width;
+	captureBuffer.height = swapChainExtent.height;
+	captureBuffer.frame = frameCount;
+
+	frameCaptureSlots[currentFrame] = slot;
+}
+
+// Called after the frame's fence wait - the copy recorded the last time this frame slot was used has landed
+void SuperSphere::collectCapture(uint32_t frame) {
+	int slot = frameCaptureSlots[frame];
+
+	if (slot < 0) {
+		return;
+	}
+
+	frameCaptureSlots[frame] = -1;
+
+	const CaptureBuffer& captureBuffer = captureBuffers[slot];
+	frameCapture.submit(slot, static_cast<const uint8_t*>(captureBuffer.allocation.mapped), captureBuffer.width, captureBuffer.height, readbackIsBgra(), captureBuffer.frame);
+}
+
+// The swapchain image is in PRESENT_SRC_KHR here, written by the render pass or the upscaling blit
+void SuperSphere::recordCapture(VkCommandBuffer commandBuffer, uint32_t imageIndex, const CaptureBuffer& captureBuffer) {
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = swapChainImages[imageIndex];
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // Tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { captureBuffer.width, captureBuffer.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, captureBuffer.buffer, 1, &region);
+
+	// Back for presentation, and the copy made visible to the encoders once the fence has passed
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = 0;
+
+	VkBufferMemoryBarrier bufferBarrier{};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = captureBuffer.buffer;
+	bufferBarrier.offset = 0;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &bufferBarrier, 1, &barrier);
 }
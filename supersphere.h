@@ -8,13 +8,21 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <atomic>
 #include <chrono>
+#include <exception>
+#include <thread>
 
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <set>
 #include <fstream>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <deque>
 
 #include <cstdint>
 #include <limits>
@@ -22,12 +30,32 @@
 
 #include "struct.h"
 #include "debug.h"
+#include "shaders.h"
+#include "startup.h"
+#include "allocator.h"
+#include "uploader.h"
+#include "mesh.h"
+#include "activity.h"
+#include "ring.h"
+#include "batch.h"
+#include "imageWriter.h"
+#include "capture.h"
+#include "shapeMetrics.h"
+#include "picking.h"
+#include "log.h"
+#include "metrics.h"
+#include "replay.h"
+#include "controlPlane.h"
 
 class SuperSphere {
 public:
 	void run();
+	void runBatch(std::istream& jobs, const std::string& outputDirectory);
 	uint64_t frameCount = 0;
 
+	// Takes effect a few frames later, once the new mesh has been generated and uploaded
+	void setDetail(size_t detail);
+
 private:
 	GLFWwindow* window;
 	VkInstance instance;
@@ -38,31 +66,94 @@ private:
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 	VkDevice device;
 
+	DeviceAllocator allocator;
+	bool memoryBudgetEnabled = false; // VK_EXT_memory_budget
+
 	// Queues
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
+	VkQueue transferQueue;
+
+	QueueFamilyIndices queueFamilyIndices;
+
+	// Background buffer uploads on the transfer queue
+	Uploader uploader;
 
 	// Window + presentation
 	VkSurfaceKHR surface;
-	VkSwapchainKHR swapChain;
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
+	VkPresentModeKHR swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
 
 	std::vector<VkImage> swapChainImages;
 	std::vector<VkImageView> swapChainImageViews;
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 
+	// Depth - one image shared by every frame in flight
+	VkFormat depthFormat;
+	VkImage depthImage = VK_NULL_HANDLE;
+	VkImageView depthImageView = VK_NULL_HANDLE;
+	Allocation depthImageAllocation;
+
+	// Dynamic resolution - drawn into the top-left corner of a full-size offscreen target, then blitted up to the swap chain
+	VkImage offscreenImage = VK_NULL_HANDLE;
+	VkImageView offscreenImageView = VK_NULL_HANDLE;
+	Allocation offscreenImageAllocation;
+	VkFramebuffer offscreenFramebuffer = VK_NULL_HANDLE;
+
+	float renderScale = 1.0f;
+	float smoothedFrameMs = 0.0f;
+	std::chrono::high_resolution_clock::time_point lastRenderScaleTime; // Only without timestamp queries
+
+	// GPU time of the scene pass - two timestamps per frame in flight; left null where the graphics queue has none
+	VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+	std::vector<bool> timestampsWritten;
+	float timestampPeriodNs = 1.0f;
+	uint64_t timestampMask = ~0ull;
+
 	bool framebufferResized = false;
+	FramebufferSize framebufferSize; // The latest size the event thread reported, for the swap chain extent
+
+	// On-demand rendering - set by any input, cleared once a frame has been drawn
+	bool redrawRequested = true;
+
+	float animationTime = 0.0f;
+	bool animationPaused = false;
+	std::chrono::steady_clock::time_point lastAnimationTime = std::chrono::steady_clock::now();
+
+	// Idle + CPU reporting, over the current ACTIVITY_REPORT_SECONDS window
+	std::chrono::high_resolution_clock::time_point activityStartTime;
+	double activityStartCpu = 0.0;
+	double activityStartEnergy = -1.0;
+	float activityIdleSeconds = 0.0f;
+	uint64_t activityFrames = 0;
+
+	std::chrono::steady_clock::time_point memoryReportTime = std::chrono::steady_clock::now();
+
+	// Resize hitch instrumentation
+	std::chrono::high_resolution_clock::time_point lastSubmitTime;
+	float swapChainRecreateMs = 0.0f;
+	float maxResizeHitchMs = 0.0f;
+	bool measuringResizeHitch = false;
 
 	// Render setup
 	VkRenderPass renderPass;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
 	VkPipeline graphicsPipeline;
+	VkPipeline overdrawPipeline; // Same state, but shades every fragment a flat additive colour
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+	// Loaded off the critical path during startup, consumed by createPipelineCache / createGraphicsPipeline
+	std::vector<char> pipelineCacheData;
+	ShaderCode vertShaderCode;
+	ShaderCode fragShaderCode;
+
+	bool pipelineCacheWarm = false; // True if the on-disk cache was valid for this device
 
 	// Command pools and scheduling
 	VkCommandPool commandPool;
-	VkCommandPool transferCommandPool;
 
 	std::vector<VkCommandBuffer> commandBuffers;
 
@@ -70,41 +161,169 @@ private:
 	std::vector<VkSemaphore> renderFinishedSemaphores;
 	std::vector<VkFence> inFlightFences;
 
-	// Unified vertex-and-index buffer
+	// Geometry - double-buffered, so a new detail level is uploaded into one slot while the other is drawn
 	size_t detail = 180;
+	size_t requestedDetail = 180;
 	
 	float radius = 2.0f;
 
-	std::vector<Vertex> vertices;
-	std::vector<uint16_t> indices;
+	Mesh initialMesh; // Generated during startup
+	Mesh pendingMesh; // Being streamed into the inactive slot
+
+	GeometrySlot geometrySlots[2];
+	uint32_t activeGeometry = 0;
+	bool geometryUploading = false;
+
+	std::future<Mesh> meshJob;
+	std::chrono::high_resolution_clock::time_point detailRequestTime;
+
+	// Deferred destruction - resources retired while frames in flight may still use them, tagged with submittedFrames
+	std::deque<std::pair<uint64_t, std::function<void()>>> deletionQueue;
+	uint64_t submittedFrames = 0;
 
-	VkBuffer unifiedBuffer;
-	VkDeviceMemory unifiedBufferMemory;
+	// Shape on screen - for shape metrics and picking on the CPU
+	SupershapeParams currentShape{}; // As last written to the uniform buffer
+
+	// Picking - the BVH is built on the first pick and refit as the shape animates, on a worker, while picks use the last
+	// tree finished. The one it replaced is kept as the next refit's starting point
+	std::unique_ptr<SurfaceBvh> pickingBvh;
+	std::unique_ptr<SurfaceBvh> pickingSpare;
+	std::future<std::unique_ptr<SurfaceBvh>> pickingJob;
+	std::chrono::high_resolution_clock::time_point pickingJobStart;
+
+	// A pick made before any tree was ready, answered once one is - a ray in model space
+	bool pickPending = false;
+	glm::vec3 pickOrigin{ 0.0f };
+	glm::vec3 pickDirection{ 0.0f };
 
 	// Camera
 	Camera camera{};
 
-	// Uniform buffers
-	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
-	std::vector<void*> uniformBuffersMapped;
+	// Render thread - owns every Vulkan call once initialisation is done, while the main thread only runs the GLFW event loop
+	std::thread renderThread;
+	std::atomic<bool> renderRunning{ false };
+	std::exception_ptr renderError;
+	Wakeup renderWake; // Input, resizes and control snapshots wake the render thread from its idle wait
+
+	// Event thread to render thread. Only the latest framebuffer size matters, so it goes through a triple buffer
+	SpscRing<WindowEvent, 1024> windowEvents;
+	TripleBuffer<FramebufferSize> framebufferSizes;
+	std::atomic<uint64_t> droppedWindowEvents{ 0 };
+
+	// Event thread timing - callbacks run and the time spent in them, taken and reset by the render thread's report
+	std::atomic<uint64_t> eventCount{ 0 };
+	std::atomic<int64_t> eventHandlingNs{ 0 };
+	std::atomic<int64_t> eventHandlingMaxNs{ 0 };
+
+	// Render thread timing over the current ACTIVITY_REPORT_SECONDS window: busy time per frame, and how long window
+	// events waited in the queue before the render thread took them
+	double renderFrameMsSum = 0.0;
+	float renderFrameMsMax = 0.0f;
+	uint64_t renderFrameCount = 0;
+	double handoffUsSum = 0.0;
+	float handoffUsMax = 0.0f;
+	uint64_t handoffCount = 0;
+
+	// Camera input - queued with timestamps by the input handlers, applied in updateUniformBuffer right before the view is built
+	SpscRing<InputEvent, 1024> inputQueue;
+	std::chrono::steady_clock::time_point lastCameraTime = std::chrono::steady_clock::now();
+	uint64_t droppedInputEvents = 0;
+
+	// Event-timestamp-to-submit latency of the events applied this frame, and its running statistics
+	std::vector<std::chrono::steady_clock::time_point> latchedEventTimes;
+	double inputLatencySumMs = 0.0;
+	float inputLatencyMaxMs = 0.0f;
+	uint64_t inputLatencyCount = 0;
+	std::chrono::steady_clock::time_point lastInputLatencyReport = std::chrono::steady_clock::now();
+
+	// Uniform ring - one persistently mapped buffer, one slot per frame in flight selected with a dynamic offset
+	VkBuffer uniformRing;
+	Allocation uniformRingAllocation;
+	VkDeviceSize uniformStride;
 
 	VkDescriptorPool descriptorPool;
-	std::vector<VkDescriptorSet> descriptorSets;
+	VkDescriptorSet descriptorSet;
+
+	glm::mat4 modelMatrix;
+	glm::mat4 viewMatrix;
+	glm::mat4 projMatrix;
+
+	// Dirty tracking - a slot is only rewritten when it holds an older version of a matrix
+	uint64_t viewVersion = 0;
+	uint64_t projVersion = 0;
+	std::vector<uint64_t> slotViewVersions;
+	std::vector<uint64_t> slotProjVersions;
+
+	// Overdraw measurement - fragment shader invocations per pixel, from a pipeline statistics query per frame in flight
+	bool overdrawMode = false;
+	VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+	std::vector<uint64_t> statisticsQueryPixels; // Pixels covered by the query in each slot, 0 if none was recorded
+
+	uint64_t overdrawFragments = 0;
+	uint64_t overdrawPixels = 0;
+	uint32_t overdrawFrames = 0;
+
+	// Batch mode - jobs drawn offscreen with the interactive pipeline and mesh, then read back, one per frame-in-flight slot
+	bool batchMode = false;
+	std::filesystem::path batchOutputDirectory;
+
+	VkRenderPass batchRenderPass = VK_NULL_HANDLE;
+	VkExtent2D batchTargetExtent{ 0, 0 };
+
+	VkImage batchColourImage = VK_NULL_HANDLE;
+	VkImageView batchColourImageView = VK_NULL_HANDLE;
+	Allocation batchColourImageAllocation;
+	VkImage batchDepthImage = VK_NULL_HANDLE;
+	VkImageView batchDepthImageView = VK_NULL_HANDLE;
+	Allocation batchDepthImageAllocation;
+	VkFramebuffer batchFramebuffer = VK_NULL_HANDLE;
+
+	std::vector<BatchSlot> batchSlots;
+	VkMemoryPropertyFlags readbackMemoryProperties;
+	std::vector<uint8_t> batchRgb;
+
+	// Frame capture - a ring of readback buffers shared with the encoder threads, and the slot each frame in flight copies into
+	FrameCapture frameCapture;
+	std::vector<CaptureBuffer> captureBuffers;
+	std::vector<int> frameCaptureSlots;
+
+	// Input recording and deterministic replay - the clock frames are advanced to comes from frameClock()
+	InputRecorder inputRecorder;
+	InputReplay inputReplay;
+
+	// Live metrics for external monitoring, published after every frame
+	MetricsPublisher metricsPublisher;
+	float fenceWaitMs = 0.0f;
+
+	// Shape and camera driven from another thread, taken once per frame in updateUniformBuffer()
+	ControlPlane controlPlane;
+	uint64_t controlEyeVersion = 0; // Of the last camera updates applied
+	uint64_t controlLookVersion = 0;
 
 	// Misc
 	uint32_t currentFrame = 0;
 
+	std::chrono::high_resolution_clock::time_point launchTime;
+
 	// Setup + basic functions
 	void initWindow();
-	void createVertices();
-	void createIndices();
 	void createInstance();
 	void initVulkan();
 	void mainLoop();
+	void renderLoop();
 	void cleanup();
 
-	uint16_t IX(int i, int j);
+	bool needsRedraw();
+	void reportActivity();
+	void reportThreadTiming(float wallSeconds);
+	void reportMemory(bool force); // Every MEMORY_REPORT_SECONDS, or now if forced
+	void publishMetrics(float frameMs);
+
+	// Input recording and replay
+	void startRecordOrReplay();
+	void finishRecordOrReplay();
+	void injectReplayInput();
+	std::chrono::steady_clock::time_point frameClock();
 
 	// Window + presentation
 	void createSurface();
@@ -131,9 +350,20 @@ private:
 		VkDebugUtilsMessageTypeFlagsEXT messageType,
 		const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
 		void* pUserData) {
-		if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
-			std::cerr << "Validation layer: " << pCallbackData->pMessage << "\n" << std::endl;
+		// Straight into the log ring - the layer's text already says what it is, and the logger filters by level
+		LogLevel level = LogLevel::Debug;
+
+		if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+			level = LogLevel::Error;
 		}
+		else if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+			level = LogLevel::Warning;
+		}
+		else if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+			level = LogLevel::Info;
+		}
+
+		logMessage(level, pCallbackData->pMessage, strlen(pCallbackData->pMessage), (uint32_t)pCallbackData->messageIdNumber);
 
 		return VK_FALSE; // Normally used to test validation layers themselves otherwise
 	}
@@ -146,31 +376,36 @@ private:
 	bool checkValidationLayerSupport();
 
 	// Render setup
+	void loadPipelineCacheFile();
+	void createPipelineCache();
+	void savePipelineCache();
+	bool isPipelineCacheCompatible(const std::vector<char>& cacheData);
 	void createGraphicsPipeline();
 	void createRenderPass();
+	VkRenderPass buildRenderPass(VkImageLayout colourFinalLayout);
 	void createFramebuffers();
 	void cleanupSwapChain();
 	void recreateSwapChain();
 
-	VkShaderModule createShaderModule(const std::vector<char>& code);
+	void createDepthResources();
+	VkFormat findDepthFormat();
 
-	static std::vector<char> readFile(const std::string& filename) {
-		std::ifstream file(filename, std::ios::ate | std::ios::binary); // ate: read from end, binary: read as binary (no text transformations)
-
-		if (!file.is_open()) {
-			throw std::runtime_error("Failed to open file!");
-		}
+	void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, MemoryPurpose purpose, VkImage& image,
+		Allocation& allocation);
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+	void destroyImage(VkImage& image, VkImageView& imageView, Allocation& allocation);
 
-		size_t fileSize = (size_t)file.tellg();
-		std::vector<char> buffer(fileSize);
+	void createOffscreenTarget();
+	VkExtent2D getRenderExtent();
+	void updateRenderScale();
+	void recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkExtent2D renderExtent);
 
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
+	void createQueryPool();
+	void createTimestampQueryPool();
+	void readOverdrawStatistics();
 
-		file.close();
-
-		return buffer;
-	}
+	void loadShaders();
+	VkShaderModule createShaderModule(const ShaderCode& shaderCode);
 
 	// Command pools and scheduling
 	void createCommandPools();
@@ -179,77 +414,177 @@ private:
 	void createSyncObjects();
 
 	// Unified vertex-and-index buffer
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size);
-	void createVertexBuffer(VkDeviceMemory& stagingBufferMemory); // Rename?
-	void createIndexBuffer(VkDeviceMemory& stagingBufferMemory);
-	void createUnifiedBuffer();
-
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MemoryPurpose purpose, VkBuffer& buffer,
+		Allocation& allocation, AllocationLifetime lifetime = AllocationLifetime::Persistent);
+	void destroyBuffer(VkBuffer& buffer, Allocation& allocation);
+
+	// Geometry
+	void createGeometry();
+	void beginGeometryUpload(GeometrySlot& slot, Mesh&& mesh);
+	void streamGeometry(GeometrySlot& slot, Mesh& mesh, VkDeviceSize budget); // Releases the mesh once it is all staged, with RELEASE_MESH_AFTER_UPLOAD
+	void updateGeometry();
+
+	void deferDestroy(std::function<void()> destroy);
+	void flushDeletionQueue(bool everything = false);
+
+	// Batch mode
+	void createBatchResources();
+	void destroyBatchResources();
+	void ensureBatchTargets(uint32_t width, uint32_t height);
+	void renderBatchJob(const BatchJob& job);
+	void recordBatchCommandBuffer(VkCommandBuffer commandBuffer, const BatchJob& job, const BatchSlot& slot);
+	void finishBatchJob(BatchSlot& slot);
+
+	// Readback
+	bool readbackFormatSupported();
+	bool readbackIsBgra();
+	VkMemoryPropertyFlags findReadbackMemoryProperties();
+
+	// Frame capture
+	void createCaptureResources();
+	void reserveCapture();
+	void collectCapture(uint32_t frame);
+	void recordCapture(VkCommandBuffer commandBuffer, uint32_t imageIndex, const CaptureBuffer& captureBuffer);
 
 	// Camera
 	void createCamera();
+	void queueInput(const InputEvent& event);
+	void latchInput(std::chrono::steady_clock::time_point now);
+	void applyControlCamera();
+	void advanceCamera(std::chrono::steady_clock::time_point time);
+	void applyInputEvent(const InputEvent& event);
+	void recordInputLatency();
+	void printShapeMetrics();
+	void pickSurface();
+	void updatePicking();
+	void reportPick(const PickHit& hit, float pickUs);
+
+	// Event thread: only what has to happen there (closing, re-centring the cursor) is done here - the rest is handed to the
+	// render thread, which records live input and runs the handlers below, or ignores it while a replay drives them
+	void postWindowEvent(const WindowEvent& event);
+	void takeWindowEvents();
+	void applyWindowEvent(const WindowEvent& event);
 
 	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 		auto app = reinterpret_cast<SuperSphere*>(glfwGetWindowUserPointer(window));
-		Camera* camera = &app->camera;
+		auto now = std::chrono::steady_clock::now();
+
+		// Making closure easier - even mid-replay
+		if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+			glfwSetWindowShouldClose(window, GLFW_TRUE);
+		}
+
+		app->postWindowEvent({ WindowEventType::Key, now, key, action, 0.0f, 0.0f });
+	}
+
+	static void cursorPosCallback(GLFWwindow* window, double x, double y) {
+		auto app = reinterpret_cast<SuperSphere*>(glfwGetWindowUserPointer(window));
+		auto now = std::chrono::steady_clock::now();
+
+		glfwSetCursorPos(window, 0, 0);
+
+		app->postWindowEvent({ WindowEventType::Cursor, now, 0, 0, (float)x, (float)y });
+	};
+
+	static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+		auto app = reinterpret_cast<SuperSphere*>(glfwGetWindowUserPointer(window));
 
+		app->postWindowEvent({ WindowEventType::MouseButton, std::chrono::steady_clock::now(), button, action, 0.0f, 0.0f });
+	}
+
+	// Render thread, from here on
+	void handleKey(int key, int action, std::chrono::steady_clock::time_point time) {
 		bool keyAction = action == GLFW_PRESS || action == GLFW_REPEAT;
 
+		redrawRequested = true;
+
 		// Key controls
 		switch (key) {
+		// Movement - timestamped and applied to the camera in order when the next frame is built
 		case GLFW_KEY_W:
-			camera->controls.forwards = action;
+		case GLFW_KEY_S:
+		case GLFW_KEY_A:
+		case GLFW_KEY_D:
+		case GLFW_KEY_LEFT_SHIFT:
+		case GLFW_KEY_SPACE:
+			if (action != GLFW_REPEAT) {
+				queueInput({ InputEventType::Key, time, key, action, 0.0f, 0.0f });
+			}
 			break;
 
-		case GLFW_KEY_S:
-			camera->controls.backwards = action;
+		case GLFW_KEY_P:
+			if (action == GLFW_PRESS) {
+				animationPaused = !animationPaused;
+			}
 			break;
 
-		case GLFW_KEY_A:
-			camera->controls.left = action;
+		// Overdraw visualisation + fragments-per-pixel report
+		case GLFW_KEY_O:
+			if (action == GLFW_PRESS) {
+				overdrawMode = !overdrawMode;
+			}
 			break;
 
-		case GLFW_KEY_D:
-			camera->controls.right = action;
+		// Area, volume and bounds of the shape on screen
+		case GLFW_KEY_M:
+			if (action == GLFW_PRESS) {
+				printShapeMetrics();
+			}
 			break;
 
-		case GLFW_KEY_LEFT_SHIFT:
-			camera->controls.down = action;
+		// Tessellation detail
+		case GLFW_KEY_EQUAL:
+			if (keyAction) {
+				setDetail(requestedDetail * 3 / 2);
+			}
 			break;
 
-		case GLFW_KEY_SPACE:
-			camera->controls.up = action;
+		case GLFW_KEY_MINUS:
+			if (keyAction) {
+				setDetail(requestedDetail * 2 / 3);
+			}
 			break;
 		}
+	}
 
-		// Making closure easier
-		if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
-			glfwSetWindowShouldClose(window, GLFW_TRUE);
+	void handleCursor(float dx, float dy, std::chrono::steady_clock::time_point time) {
+		// Re-centring the cursor can report a zero move, which mustn't keep the window awake
+		if (dx != 0.0f || dy != 0.0f) {
+			redrawRequested = true;
+			queueInput({ InputEventType::CursorMove, time, 0, 0, dx, dy });
 		}
 	}
 
-	static void cursorPosCallback(GLFWwindow* window, double x, double y) {
-		auto app = reinterpret_cast<SuperSphere*>(glfwGetWindowUserPointer(window));
-
-		app->camera.theta -= (float)x * app->camera.sensitivity;
-		app->camera.phi += (float)y * app->camera.sensitivity;
-
-		glfwSetCursorPos(window, 0, 0);
-	};
+	void handleMouseButton(int button, int action) {
+		if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+			pickSurface();
+		}
+	}
 
 	// Uniform buffers and descriptors
 	void createDescriptorSetLayout();
 	void createUniformBuffers();
 	void updateUniformBuffer(uint32_t currentImage);
+	void updateProjection();
 	void createDescriptorPool();
 	void createDescriptorSets();
 
 	// Main rendering and event handling
-	void drawFrame();
+	bool drawFrame();
 
+	// Event thread
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
 		auto app = reinterpret_cast<SuperSphere*>(glfwGetWindowUserPointer(window));
-		app->framebufferResized = true;
+
+		app->framebufferSizes.back() = { width, height };
+		app->framebufferSizes.publish();
+		app->renderWake.notify();
+	}
+
+	// The window was exposed or damaged and its contents need drawing again
+	static void windowRefreshCallback(GLFWwindow* window) {
+		auto app = reinterpret_cast<SuperSphere*>(glfwGetWindowUserPointer(window));
+
+		app->postWindowEvent({ WindowEventType::Refresh, std::chrono::steady_clock::now(), 0, 0, 0.0f, 0.0f });
 	}
 };
@@ -0,0 +1,97 @@
+/*
+Prints the live metrics a running SuperSphere publishes (metrics.h), once or, with --tail, twice a second until interrupted.
+
+	g++ -std=c++17 -O2 -I.. metricsReader.cpp ../metrics.cpp -o metricsReader	(add -lrt on older glibc)
+	./metricsReader [--tail] <process id | name>
+
+A process id reads /supersphere-metrics-<process id>, the block that SuperSphere instance publishes.
+*/
+
+#include "metrics.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+static const char* presentModeName(uint32_t presentMode) {
+	switch (presentMode) {
+	case 0: return "immediate";
+	case 1: return "mailbox";
+	case 2: return "fifo";
+	case 3: return "fifo relaxed";
+	default: return "other";
+	}
+}
+
+static void printMetrics(const MetricsBlock* block, const MetricsData& data) {
+	uint64_t nowNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	double ageMs = nowNs > data.updateTimeNs ? (double)(nowNs - data.updateTimeNs) * 1e-6 : 0.0;
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "pid " << block->processId << ", frame " << data.frameCount << " (updated " << ageMs << " ms ago)\n"
+		<< "\tframe ms  last " << data.frameMs << "  p50 " << data.frameMsP50 << "  p95 " << data.frameMsP95 << "  p99 " << data.frameMsP99
+		<< "  max " << data.frameMsMax << "\n"
+		<< "\tfence ms  last " << data.fenceWaitMs << "  p99 " << data.fenceWaitMsP99 << "\n"
+		<< "\t" << data.width << "x" << data.height << ", " << presentModeName(data.presentMode) << ", detail " << data.detail << ", "
+		<< data.vertexCount << " vertices, " << data.indexCount << " indices\n"
+		<< "\tdevice memory " << data.deviceMemoryUsed / 1024 << " / " << data.deviceMemoryReserved / 1024 << " KiB used in "
+		<< data.deviceAllocations << " allocations" << std::endl;
+}
+
+int main(int argc, char** argv) {
+	std::string name;
+	bool tail = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--tail") == 0) {
+			tail = true;
+		}
+		else if (std::isdigit((unsigned char)argv[i][0])) {
+			name = metricsBlockName("/supersphere-metrics", (uint32_t)std::strtoul(argv[i], nullptr, 10));
+		}
+		else {
+			name = argv[i];
+		}
+	}
+
+	if (name.empty()) {
+		std::cerr << "Usage: metricsReader [--tail] <process id | name>" << std::endl;
+		return 1;
+	}
+
+	MetricsBlock* block = mapMetricsBlock(name.c_str(), false);
+
+	if (block == nullptr) {
+		std::cerr << "No metrics published as " << name << " - is SuperSphere running?" << std::endl;
+		return 1;
+	}
+
+	if (block->magic != METRICS_MAGIC || block->version != METRICS_VERSION || block->size != sizeof(MetricsBlock)) {
+		std::cerr << "Metrics block " << name << " has an unknown layout (version " << block->version << ")" << std::endl;
+		return 1;
+	}
+
+	do {
+		MetricsData data;
+
+		if (readMetrics(block, data)) {
+			printMetrics(block, data);
+		}
+		else {
+			std::cerr << "Writer stuck mid-update - it may have crashed" << std::endl;
+		}
+
+		if (tail) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		}
+	} while (tail);
+
+	unmapMetricsBlock(block, name.c_str(), false);
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+/*
+Runs benchmarkShapeMetrics() (shapeMetrics.h): area, volume and bounds of a supershape at detail levels up to maxDetail,
+timed on one thread and on all of them, with how far each result moved from the previous level. With --precision, runs
+reportPrecisionTiers() (fastMath.h) instead: each tier's error and throughput.
+
+	g++ -std=c++17 -O3 -march=native -fno-math-errno -pthread -I.. shapeBenchmark.cpp ../shapeMetrics.cpp ../fastMath.cpp ../log.cpp -o shapeBenchmark
+	./shapeBenchmark [maxDetail] [m n1 n2 n3 a b]
+	./shapeBenchmark --precision
+*/
+
+#include "shapeMetrics.h"
+#include "fastMath.h"
+#include "log.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char** argv) {
+	if (argc == 2 && std::strcmp(argv[1], "--precision") == 0) {
+		reportPrecisionTiers();
+		flushLog();
+
+		return 0;
+	}
+
+	size_t maxDetail = 10000;
+	SupershapeParams shape;
+	shape.m = 6.0f;
+
+	if (argc > 1) {
+		maxDetail = (size_t)std::strtoull(argv[1], nullptr, 10);
+	}
+
+	if (argc > 2 && argc != 8) {
+		std::cerr << "Usage: " << argv[0] << " [maxDetail] [m n1 n2 n3 a b] | --precision" << std::endl;
+		return 1;
+	}
+
+	if (argc == 8) {
+		float* fields[] = { &shape.m, &shape.n1, &shape.n2, &shape.n3, &shape.a, &shape.b };
+
+		for (int i = 0; i < 6; i++) {
+			*fields[i] = std::strtof(argv[i + 2], nullptr);
+		}
+	}
+
+	benchmarkShapeMetrics(shape, maxDetail);
+	flushLog();
+
+	return 0;
+}
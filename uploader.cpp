@@ -0,0 +1,199 @@
+#include "uploader.h"
+#include "log.h"
+
+#include <cstring>
+#include <stdexcept>
+
+void Uploader::init(VkDevice device, DeviceAllocator* allocator, VkQueue queue, uint32_t queueFamily) {
+	this->device = device;
+	this->allocator = allocator;
+	this->queue = queue;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create transfer command pool!");
+	}
+
+	VkSemaphoreTypeCreateInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineInfo;
+
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create upload timeline semaphore!");
+	}
+}
+
+void Uploader::destroy() {
+	wait(lastSubmittedValue);
+	collect();
+
+	for (StagingBuffer& staging : pendingStagingBuffers) {
+		vkDestroyBuffer(device, staging.buffer, nullptr);
+		allocator->free(staging.allocation);
+	}
+
+	pendingStagingBuffers.clear();
+	pendingCopies.clear();
+
+	LogLine(LogLevel::Info) << "Uploader: " << copyCount << " copies (" << bytesUploaded / 1024 << " KiB) in " << batchCount << " submissions";
+
+	vkDestroySemaphore(device, timeline, nullptr);
+	vkDestroyCommandPool(device, commandPool, nullptr);
+}
+
+void Uploader::enqueue(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+	memcpy(enqueueWrite(dstBuffer, dstOffset, size), data, (size_t)size);
+}
+
+void* Uploader::enqueueWrite(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size) {
+	StagingBuffer staging{};
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // Only ever touched by the transfer queue
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &staging.buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create staging buffer!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device, staging.buffer, &memRequirements);
+
+	staging.allocation = allocator->allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		MemoryPurpose::Staging, AllocationLifetime::Transient);
+	vkBindBufferMemory(device, staging.buffer, staging.allocation.memory, staging.allocation.offset);
+
+	PendingCopy copy{};
+	copy.srcBuffer = staging.buffer;
+	copy.dstBuffer = dstBuffer;
+	copy.region.srcOffset = 0;
+	copy.region.dstOffset = dstOffset;
+	copy.region.size = size;
+
+	pendingCopies.push_back(copy);
+	pendingStagingBuffers.push_back(staging);
+
+	return staging.allocation.mapped;
+}
+
+uint64_t Uploader::flush() {
+	if (pendingCopies.empty()) {
+		return lastSubmittedValue;
+	}
+
+	VkCommandBuffer commandBuffer;
+
+	if (!freeCommandBuffers.empty()) {
+		commandBuffer = freeCommandBuffers.back();
+		freeCommandBuffers.pop_back();
+		vkResetCommandBuffer(commandBuffer, 0);
+	}
+	else {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate transfer command buffer!");
+		}
+	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording transfer buffer!");
+	}
+
+	for (const PendingCopy& copy : pendingCopies) {
+		vkCmdCopyBuffer(commandBuffer, copy.srcBuffer, copy.dstBuffer, 1, &copy.region);
+
+		copyCount++;
+		bytesUploaded += copy.region.size;
+	}
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record transfer buffer!");
+	}
+
+	uint64_t signalValue = lastSubmittedValue + 1;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &timeline;
+
+	if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit transfer batch!");
+	}
+
+	lastSubmittedValue = signalValue;
+	batchCount++;
+
+	inFlightBatches.push_back({ signalValue, commandBuffer, std::move(pendingStagingBuffers) });
+	pendingStagingBuffers.clear();
+	pendingCopies.clear();
+
+	return signalValue;
+}
+
+bool Uploader::isComplete(uint64_t value) {
+	uint64_t completedValue = 0;
+	vkGetSemaphoreCounterValue(device, timeline, &completedValue);
+
+	return completedValue >= value;
+}
+
+void Uploader::wait(uint64_t value) {
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &timeline;
+	waitInfo.pValues = &value;
+
+	vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+}
+
+void Uploader::collect() {
+	if (inFlightBatches.empty()) {
+		return;
+	}
+
+	uint64_t completedValue = 0;
+	vkGetSemaphoreCounterValue(device, timeline, &completedValue);
+
+	// Batches complete in submission order, and staging memory came from the ring in that same order
+	while (!inFlightBatches.empty() && inFlightBatches.front().value <= completedValue) {
+		Batch& batch = inFlightBatches.front();
+
+		for (StagingBuffer& staging : batch.stagingBuffers) {
+			vkDestroyBuffer(device, staging.buffer, nullptr);
+			allocator->free(staging.allocation);
+		}
+
+		freeCommandBuffers.push_back(batch.commandBuffer);
+		inFlightBatches.pop_front();
+	}
+}
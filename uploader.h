@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <vector>
+
+#include "allocator.h"
+
+/*
+Batches buffer uploads onto a transfer-capable queue (a dedicated transfer family when the GPU has one), without ever
+idling a queue. Copies are queued with enqueue(), sent as a single submission by flush(), and completion is tracked with
+a timeline semaphore: flush() returns the value the semaphore reaches once that batch has landed.
+
+Consumers on other queues wait for that value on the GPU (see getTimeline), rather than the CPU waiting for the copy.
+Destination buffers must be usable from both the transfer and graphics families (concurrent sharing when they differ).
+
+The queue may be the graphics queue itself, on GPUs with nothing else to offer. Uploads then run in submission order with
+the frames, and flush() must be called from the thread that submits them, since queue access isn't synchronised here.
+*/
+
+class Uploader {
+public:
+	void init(VkDevice device, DeviceAllocator* allocator, VkQueue queue, uint32_t queueFamily);
+	void destroy();
+
+	// The data is copied into staging memory straight away, so it can be released as soon as this returns
+	void enqueue(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+	// Queues a copy of size bytes of staging memory, returned for the caller to fill before the next flush() - for data
+	// that has to be converted anyway, so it is written once instead of built elsewhere and copied in
+	void* enqueueWrite(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size);
+
+	// Submits everything enqueued since the last flush; returns the timeline value that signals its completion
+	uint64_t flush();
+
+	bool isComplete(uint64_t value);
+	void wait(uint64_t value);
+
+	// Releases staging memory and command buffers of batches that have completed
+	void collect();
+
+	VkSemaphore getTimeline() const { return timeline; }
+	uint64_t getLastSubmittedValue() const { return lastSubmittedValue; }
+
+private:
+	struct StagingBuffer {
+		VkBuffer buffer;
+		Allocation allocation;
+	};
+
+	struct PendingCopy {
+		VkBuffer srcBuffer;
+		VkBuffer dstBuffer;
+		VkBufferCopy region;
+	};
+
+	struct Batch {
+		uint64_t value;
+		VkCommandBuffer commandBuffer;
+		std::vector<StagingBuffer> stagingBuffers;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceAllocator* allocator = nullptr;
+	VkQueue queue = VK_NULL_HANDLE;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> freeCommandBuffers;
+
+	VkSemaphore timeline = VK_NULL_HANDLE;
+	uint64_t lastSubmittedValue = 0;
+
+	std::vector<PendingCopy> pendingCopies;
+	std::vector<StagingBuffer> pendingStagingBuffers;
+
+	std::deque<Batch> inFlightBatches;
+
+	// Statistics
+	uint64_t batchCount = 0;
+	uint64_t copyCount = 0;
+	VkDeviceSize bytesUploaded = 0;
+};